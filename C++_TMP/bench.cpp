@@ -0,0 +1,179 @@
+// Runtime microbenchmarks for the library, built as the separate "bench" target.
+//
+//   bench [--filter text] [--repetitions n] [--min-time-ms ms] [--warmup-ms ms] [--cpu n] [--json file] [--csv file]
+//
+// The benchmarking thread is pinned to the CPU it starts on unless --cpu says otherwise (-1 disables pinning).
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <list>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <sched.h>
+
+#include "bench.h"
+#include "benchmarks.h"
+#include "distance.h"
+#include "kd_tree.h"
+#include "perf_counters.h"
+#include "policies.h"
+#include "serialization.h"
+#include "soa.h"
+#include "solutions.h"
+#include "traits.h"
+#include "tuple_cat.h"
+#include "type_registry.h"
+#include "variadics.h"
+
+namespace {
+
+    class null_sink : public variadics::sink {
+    public:
+        void write(char const*, size_t) override {
+        }
+    };
+
+    void add_copy_benchmarks(bench::runner& runner) {
+        for (size_t count : { size_t{ 1024 }, size_t{ 256 * 1024 } }) {
+            std::string suffix = "/" + std::to_string(count);
+            std::vector<int> ints(count, 42), int_target(count);
+            runner.add("copy/traits::copy/vector<int>" + suffix, [=]() mutable {
+                bench::do_not_optimize(ints);
+                traits::copy(ints.begin(), ints.end(), int_target.begin());
+                bench::do_not_optimize(int_target);
+            });
+            runner.add("copy/std::copy/vector<int>" + suffix, [=]() mutable {
+                bench::do_not_optimize(ints);
+                std::copy(ints.begin(), ints.end(), int_target.begin());
+                bench::do_not_optimize(int_target);
+            });
+
+            std::list<int> list(count / 16, 42);
+            std::vector<int> list_target(count / 16);
+            runner.add("copy/traits::copy/list<int>/" + std::to_string(count / 16), [=]() mutable {
+                traits::copy(list.begin(), list.end(), list_target.begin());
+                bench::do_not_optimize(list_target);
+            });
+        }
+
+        std::vector<std::string> strings(1024, "a string too long for small string optimization");
+        std::vector<std::string> string_target(strings.size());
+        runner.add("copy/traits::copy/vector<string>/1024", [=]() mutable {
+            traits::copy(strings.begin(), strings.end(), string_target.begin());
+            bench::do_not_optimize(string_target);
+        });
+    }
+
+    void add_printf_benchmarks(bench::runner& runner) {
+        runner.add("printf/variadics::printf", [] {
+            int i = 42;
+            double d = 3.14;
+            bench::do_not_optimize(i);
+            bench::do_not_optimize(d);
+            variadics::printf("i = %, s = %, d = %\n", i, "hello", d);
+        });
+        runner.add("printf/variadics::print", [] {
+            int i = 42;
+            bench::do_not_optimize(i);
+            variadics::print(i, "hello", 3.14);
+        });
+        runner.add("printf/snprintf", [] {
+            char buffer[64];
+            int i = 42;
+            double d = 3.14;
+            bench::do_not_optimize(i);
+            bench::do_not_optimize(d);
+            std::snprintf(buffer, sizeof(buffer), "i = %d, s = %s, d = %g\n", i, "hello", d);
+            bench::do_not_optimize(buffer);
+        });
+    }
+
+    void add_solutions_benchmarks(bench::runner& runner) {
+        auto p1 = std::make_tuple(1, 0, 2), p2 = std::make_tuple(4, 4, 2);
+        runner.add("solutions/lab1_direct::euclidean_distance", [=]() mutable {
+            bench::do_not_optimize(p1);
+            bench::do_not_optimize(solutions::lab1_direct::euclidean_distance(p1, p2));
+        });
+        runner.add("solutions/lab1_sequences::euclidean_distance", [=]() mutable {
+            bench::do_not_optimize(p1);
+            bench::do_not_optimize(solutions::lab1_sequences::euclidean_distance(p1, p2));
+        });
+
+        auto tup = std::make_tuple(1.0, std::string{ "hello" }, 42);
+        runner.add("solutions/lab2::get", [=]() mutable {
+            bench::do_not_optimize(tup);
+            bench::do_not_optimize(solutions::lab2::get<int>(tup));
+        });
+
+        solutions::tests::add_search_benchmarks<int>(runner, "int", 1024);
+        solutions::tests::add_search_benchmarks<char>(runner, "char", 64 * 1024);
+        solutions::tests::add_search_benchmarks<float>(runner, "float", 4 * 1024 * 1024);
+
+        runner.add("solutions/lab5::window", [] {
+            solutions::lab5::toolbar toolbar;
+            solutions::lab5::window window{ toolbar };
+            bench::do_not_optimize(window);
+        });
+
+        runner.add("solutions/lab6::array_to_tuple+invoke", [] {
+            int arr[] = { 1, 2, 3, 4 };
+            bench::do_not_optimize(arr);
+            auto t = solutions::lab6::array_to_tuple(arr);
+            bench::do_not_optimize(solutions::lab6::invoke([](int a, int b, int c, int d) { return a + b + c + d; }, std::move(t)));
+        });
+    }
+
+    bench::options parse_options(int argc, char* argv[]) {
+        bench::options opts;
+        opts.cpu = sched_getcpu();
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (i + 1 >= argc)
+                throw std::invalid_argument("missing value for " + arg);
+            std::string value = argv[++i];
+            if (arg == "--filter") opts.filter = value;
+            else if (arg == "--repetitions") opts.repetitions = static_cast<unsigned>(std::stoul(value));
+            else if (arg == "--min-time-ms") opts.min_time = std::chrono::milliseconds(std::stoul(value));
+            else if (arg == "--warmup-ms") opts.warmup = std::chrono::milliseconds(std::stoul(value));
+            else if (arg == "--cpu") opts.cpu = std::stoi(value);
+            else if (arg == "--json") opts.json_path = value;
+            else if (arg == "--csv") opts.csv_path = value;
+            else throw std::invalid_argument("unknown option " + arg);
+        }
+        return opts;
+    }
+
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        bench::options opts = parse_options(argc, argv);
+
+        null_sink sink;
+        variadics::sink& previous = variadics::set_sink(sink);
+
+        bench::runner runner;
+        tupcat::tests::add_benchmarks(runner);
+        policies::tests::add_benchmarks(runner);
+        serialization::tests::add_benchmarks(runner);
+        soa::tests::add_benchmarks(runner);
+        geometry::tests::add_benchmarks(runner);
+        geometry::tests::add_kd_tree_benchmarks(runner);
+        registry::tests::add_benchmarks(runner);
+        add_copy_benchmarks(runner);
+        add_printf_benchmarks(runner);
+        add_solutions_benchmarks(runner);
+        runner.run(opts);
+        variadics::set_sink(previous);
+        if (perfcounters::default_policy::enabled) {
+            perfcounters::write_report(std::cout, perfcounters::snapshot());
+        }
+        return 0;
+    } catch (std::exception const& e) {
+        std::cerr << "bench: " << e.what() << '\n';
+        return 1;
+    }
+}
@@ -0,0 +1,296 @@
+#ifndef TMP_BENCH_H
+#define TMP_BENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sched.h>
+
+#include "perf_counters.h"
+
+namespace bench {
+
+    // Makes the compiler assume the value is read, so the computation that produced it can't be dropped
+    template <typename T>
+    void do_not_optimize(T const& value) {
+        asm volatile("" : : "m"(value) : "memory");
+    }
+
+    // ...and that it may have been changed, so it can't be constant-folded into the next iteration either
+    template <typename T>
+    void do_not_optimize(T& value) {
+        asm volatile("" : "+m"(value) : : "memory");
+    }
+
+    // Forces pending writes to memory to be treated as observable
+    void clobber_memory() {
+        asm volatile("" : : : "memory");
+    }
+
+    struct options {
+        std::chrono::milliseconds warmup{ 50 };
+        // Each repetition runs enough iterations to take at least this long
+        std::chrono::milliseconds min_time{ 20 };
+        unsigned repetitions = 15;
+        // CPU to pin the benchmarking thread to; -1 leaves the affinity alone
+        int cpu = -1;
+        // Runs only the benchmarks whose name contains this
+        std::string filter;
+        std::string json_path;
+        std::string csv_path;
+    };
+
+    struct result {
+        std::string name;
+        size_t iterations = 0;
+        // Nanoseconds per iteration, one sample per repetition
+        std::vector<double> samples;
+        double median = 0;
+        // Median absolute deviation from the median
+        double mad = 0;
+        double min = 0;
+        double max = 0;
+        double p5 = 0;
+        double p25 = 0;
+        double p75 = 0;
+        double p95 = 0;
+        // Hardware counts per iteration over all repetitions, when perfcounters::default_policy is enabled and
+        // the counters could be opened on the benchmarking thread
+        bool counted = false;
+        double counters[perfcounters::COUNTER_COUNT] = {};
+    };
+
+    namespace detail {
+
+        // Linear interpolation between the closest ranks; 'sorted' must not be empty
+        double percentile(std::vector<double> const& sorted, double p) {
+            double rank = p / 100.0 * (sorted.size() - 1);
+            size_t below = static_cast<size_t>(rank);
+            size_t above = std::min(below + 1, sorted.size() - 1);
+            return sorted[below] + (sorted[above] - sorted[below]) * (rank - below);
+        }
+
+        void compute_statistics(result& r) {
+            std::vector<double> sorted = r.samples;
+            std::sort(sorted.begin(), sorted.end());
+            r.median = percentile(sorted, 50);
+            r.min = sorted.front();
+            r.max = sorted.back();
+            r.p5 = percentile(sorted, 5);
+            r.p25 = percentile(sorted, 25);
+            r.p75 = percentile(sorted, 75);
+            r.p95 = percentile(sorted, 95);
+
+            std::vector<double> deviations;
+            for (double sample : sorted) {
+                deviations.push_back(std::abs(sample - r.median));
+            }
+            std::sort(deviations.begin(), deviations.end());
+            r.mad = percentile(deviations, 50);
+        }
+
+        // Runs a benchmark body a given number of times; the loop is compiled around the body itself, so
+        // the type erasure costs one call per batch rather than one per iteration
+        using batch_fn = std::function<void(size_t)>;
+
+        template <typename Fn>
+        batch_fn make_batch(Fn fn) {
+            return [fn](size_t iterations) mutable {
+                for (size_t i = 0; i < iterations; ++i) {
+                    fn();
+                }
+            };
+        }
+
+        double time_batch(batch_fn const& batch, size_t iterations) {
+            auto start = std::chrono::steady_clock::now();
+            batch(iterations);
+            auto end = std::chrono::steady_clock::now();
+            return std::chrono::duration<double, std::nano>(end - start).count();
+        }
+
+        std::string json_string(std::string const& s) {
+            std::string out = "\"";
+            for (char c : s) {
+                if (c == '"' || c == '\\') {
+                    out += '\\';
+                }
+                out += c;
+            }
+            return out + "\"";
+        }
+
+        std::string csv_field(std::string const& s) {
+            if (s.find_first_of(",\"") == std::string::npos)
+                return s;
+            std::string out = "\"";
+            for (char c : s) {
+                out += c;
+                if (c == '"') {
+                    out += '"';
+                }
+            }
+            return out + "\"";
+        }
+
+    }
+
+    // Runs the batch for the warmup period, then doubles the iteration count until one batch takes at least
+    // min_time, then times that many iterations once per repetition
+    result measure(std::string const& name, detail::batch_fn const& batch, options const& opts) {
+        using namespace std::chrono;
+
+        auto warmup_end = steady_clock::now() + opts.warmup;
+        do {
+            batch(1);
+        } while (steady_clock::now() < warmup_end);
+
+        double min_ns = duration<double, std::nano>(opts.min_time).count();
+        size_t iterations = 1;
+        for (;;) {
+            double elapsed = detail::time_batch(batch, iterations);
+            if (elapsed >= min_ns)
+                break;
+            // Jump most of the way there at once when the estimate is trustworthy, otherwise keep doubling
+            size_t estimate = elapsed > min_ns / 100 ? static_cast<size_t>(iterations * min_ns / elapsed * 1.1) : 0;
+            iterations = std::max(iterations * 2, estimate);
+        }
+
+        result r;
+        r.name = name;
+        r.iterations = iterations;
+        perfcounters::counter_values counts;
+        for (unsigned rep = 0; rep < std::max(1u, opts.repetitions); ++rep) {
+            auto start = perfcounters::default_policy::start();
+            r.samples.push_back(detail::time_batch(batch, iterations) / iterations);
+            counts += perfcounters::default_policy::stop(name.c_str(), start);
+        }
+        detail::compute_statistics(r);
+        r.counted = perfcounters::default_policy::counting();
+        for (int c = 0; c < perfcounters::COUNTER_COUNT; ++c) {
+            r.counters[c] = static_cast<double>(counts.values[c]) / (iterations * r.samples.size());
+        }
+        return r;
+    }
+
+    template <typename Fn>
+    result measure(std::string const& name, Fn fn, options const& opts) {
+        return measure(name, detail::make_batch(std::move(fn)), opts);
+    }
+
+    void pin_to_cpu(int cpu) {
+        if (cpu < 0)
+            return;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0)
+            throw std::runtime_error("can't pin to CPU " + std::to_string(cpu));
+    }
+
+    void write_json(std::ostream& out, std::vector<result> const& results) {
+        out << "[\n";
+        for (size_t i = 0; i < results.size(); ++i) {
+            auto const& r = results[i];
+            out << "  {\"name\": " << detail::json_string(r.name) << ", \"iterations\": " << r.iterations
+                << ", \"median_ns\": " << r.median << ", \"mad_ns\": " << r.mad
+                << ", \"min_ns\": " << r.min << ", \"max_ns\": " << r.max
+                << ", \"p5_ns\": " << r.p5 << ", \"p25_ns\": " << r.p25
+                << ", \"p75_ns\": " << r.p75 << ", \"p95_ns\": " << r.p95;
+            if (r.counted) {
+                for (int c = 0; c < perfcounters::COUNTER_COUNT; ++c) {
+                    out << ", \"" << perfcounters::counter_name(static_cast<perfcounters::counter>(c)) << "\": " << r.counters[c];
+                }
+            }
+            out << ", \"samples_ns\": [";
+            for (size_t j = 0; j < r.samples.size(); ++j) {
+                out << (j == 0 ? "" : ", ") << r.samples[j];
+            }
+            out << "]}" << (i + 1 == results.size() ? "" : ",") << "\n";
+        }
+        out << "]\n";
+    }
+
+    void write_csv(std::ostream& out, std::vector<result> const& results) {
+        bool counted = std::any_of(results.begin(), results.end(), [](result const& r) { return r.counted; });
+        out << "name,iterations,median_ns,mad_ns,min_ns,max_ns,p5_ns,p25_ns,p75_ns,p95_ns";
+        for (int c = 0; counted && c < perfcounters::COUNTER_COUNT; ++c) {
+            out << ',' << perfcounters::counter_name(static_cast<perfcounters::counter>(c));
+        }
+        out << '\n';
+        for (auto const& r : results) {
+            out << detail::csv_field(r.name) << ',' << r.iterations << ',' << r.median << ',' << r.mad << ','
+                << r.min << ',' << r.max << ',' << r.p5 << ',' << r.p25 << ',' << r.p75 << ',' << r.p95;
+            for (int c = 0; counted && c < perfcounters::COUNTER_COUNT; ++c) {
+                out << ',' << r.counters[c];
+            }
+            out << '\n';
+        }
+    }
+
+    void print_result(result const& r) {
+        char line[256];
+        std::snprintf(line, sizeof(line), "%-48s %12.2f ns  \xc2\xb1 %8.2f  [p5 %10.2f, p95 %10.2f]  x%zu\n",
+                      r.name.c_str(), r.median, r.mad, r.p5, r.p95, r.iterations);
+        std::cout << line;
+        if (r.counted) {
+            std::snprintf(line, sizeof(line), "%-48s %12.1f cyc  %10.1f ins  %8.3f cache-miss  %8.3f branch-miss\n", "",
+                          r.counters[perfcounters::cycles], r.counters[perfcounters::instructions],
+                          r.counters[perfcounters::cache_misses], r.counters[perfcounters::branch_misses]);
+            std::cout << line;
+        }
+        std::cout << std::flush;
+    }
+
+    // A set of named benchmarks that are run, reported and written out together
+    class runner {
+        struct entry {
+            std::string name;
+            detail::batch_fn batch;
+        };
+
+        std::vector<entry> entries_;
+
+    public:
+        template <typename Fn>
+        void add(std::string name, Fn fn) {
+            entries_.push_back(entry{ std::move(name), detail::make_batch(std::move(fn)) });
+        }
+
+        std::vector<result> run(options const& opts = options{}) const {
+            pin_to_cpu(opts.cpu);
+            std::vector<result> results;
+            for (auto const& e : entries_) {
+                if (e.name.find(opts.filter) == std::string::npos)
+                    continue;
+                results.push_back(measure(e.name, e.batch, opts));
+                print_result(results.back());
+            }
+
+            if (!opts.json_path.empty()) {
+                std::ofstream out{ opts.json_path };
+                if (!out)
+                    throw std::runtime_error("can't write " + opts.json_path);
+                write_json(out, results);
+            }
+            if (!opts.csv_path.empty()) {
+                std::ofstream out{ opts.csv_path };
+                if (!out)
+                    throw std::runtime_error("can't write " + opts.csv_path);
+                write_csv(out, results);
+            }
+            return results;
+        }
+    };
+
+}
+
+#endif //TMP_BENCH_H
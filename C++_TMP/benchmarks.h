@@ -0,0 +1,378 @@
+#ifndef TMP_BENCHMARKS_H
+#define TMP_BENCHMARKS_H
+
+#include <algorithm>
+#include <complex>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include "bench.h"
+#include "distance.h"
+#include "kd_tree.h"
+#include "mapped_file.h"
+#include "parallel_search.h"
+#include "range_reductions.h"
+#include "serialization.h"
+#include "soa.h"
+#include "solutions.h"
+#include "tuple_cat.h"
+#include "type_registry.h"
+
+// The benchmark fixtures of the library's headers, registered by the bench target and run by the *_perf
+// functions. They live here rather than next to the code they measure, so that including a header doesn't
+// also parse the harness.
+namespace bench {
+
+    // Runs the benchmarks that 'add' registers with the default options
+    template <typename Add>
+    void run(Add add) {
+        runner runner;
+        add(runner);
+        runner.run();
+    }
+
+    // How the fixtures that take a size name their benchmarks
+    std::string sized(std::string const& name, size_t size) {
+        return name + "/" + std::to_string(size);
+    }
+
+}
+
+namespace tupcat
+{
+    namespace tests
+    {
+        // Simple and complex source tuples that every iteration concatenates, as lvalues
+        template <typename Catter>
+        void add_benchmarks(bench::runner& runner, std::string const& description, Catter catter)
+        {
+            {
+                auto tup1 = std::make_tuple(1, 2);
+                auto tup2 = std::make_tuple('a', 4.0f);
+                auto tup3 = std::make_tuple(3ull, L'c', 17);
+                auto tup4 = std::make_tuple(0, 47.0);
+                runner.add("tuple_cat/simple/" + description, [=] {
+                    auto result = catter(tup1, tup2, tup3, tup4);
+                    bench::do_not_optimize(result);
+                });
+            }
+            {
+                auto tup1 = std::make_tuple(17, std::string{ "hello" }, std::complex<double>(14.0, 3.5));
+                auto tup2 = std::make_tuple('a', std::vector<int>{1, 2, 3}, 42);
+                auto tup3 = std::make_tuple(3ull, L'c', 17);
+                runner.add("tuple_cat/complex/" + description, [=] {
+                    auto result = catter(tup1, tup2, tup3);
+                    bench::do_not_optimize(result);
+                });
+            }
+        }
+
+        // The sources are temporaries, so catters that forward can move the strings and vectors instead of
+        // copying them. Building the sources is part of every iteration.
+        template <typename Catter>
+        void add_temporaries_benchmark(bench::runner& runner, std::string const& description, Catter catter)
+        {
+            runner.add("tuple_cat/temporaries/" + description, [=] {
+                auto result = catter(
+                        std::make_tuple(17, std::string{ "a string too long for small string optimization" }),
+                        std::make_tuple('a', std::vector<int>{1, 2, 3}, 42));
+                bench::do_not_optimize(result);
+            });
+        }
+
+        void add_benchmarks(bench::runner& runner)
+        {
+            add_benchmarks(runner, "direct", [](auto&&... args) { return direct::tuple_cat(args...); });
+            add_benchmarks(runner, "2d", [](auto&&... args) { return twodimensional::tuple_cat(args...); });
+            add_benchmarks(runner, "inplace", [](auto&&... args) { return inplace::tuple_cat(args...); });
+            add_benchmarks(runner, "view", [](auto&... args) { return lazy::make_tuple_cat_view(args...); });
+            add_benchmarks(runner, "std::tuple_cat", [](auto&&... args) { return std::tuple_cat(args...); });
+            add_benchmarks(runner, "empty loop", [](auto&&...) { return std::make_tuple(1); });
+
+            add_temporaries_benchmark(runner, "direct", [](auto&&... args) { return direct::tuple_cat(std::forward<decltype(args)>(args)...); });
+            add_temporaries_benchmark(runner, "2d", [](auto&&... args) { return twodimensional::tuple_cat(std::forward<decltype(args)>(args)...); });
+            add_temporaries_benchmark(runner, "inplace", [](auto&&... args) { return inplace::tuple_cat(std::forward<decltype(args)>(args)...); });
+            add_temporaries_benchmark(runner, "std::tuple_cat", [](auto&&... args) { return std::tuple_cat(std::forward<decltype(args)>(args)...); });
+        }
+
+    }
+
+    void tuple_cat_perf()
+    {
+        bench::run([](bench::runner& runner) { tests::add_benchmarks(runner); });
+    }
+}
+
+namespace serialization {
+
+    namespace tests {
+
+        void add_benchmarks(bench::runner& runner, size_t size = 10000) {
+            auto s = std::make_shared<state>(make_state(size));
+            runner.add(bench::sized("serialization/dump", size), [s] {
+                std::ostringstream out;
+                member_detection::dump(out, s->samples);
+                member_detection::dump(out, s->rows);
+                member_detection::dump(out, s->names);
+                bench::do_not_optimize(out);
+            });
+            runner.add(bench::sized("serialization/serialize", size), [s] {
+                std::ostringstream out;
+                buffered_writer writer{ out };
+                serialize(writer, std::tie(s->samples, s->rows, s->names));
+                writer.flush();
+                bench::do_not_optimize(out);
+            });
+        }
+
+    }
+
+    void serialization_perf() {
+        bench::run([](bench::runner& runner) { tests::add_benchmarks(runner, 1000000); });
+    }
+
+    // Opening a saved state and summing its samples, by loading everything and by mapping the file
+    void mapped_file_perf() {
+        using saved_state = std::tuple<std::vector<double>, std::vector<std::vector<int>>, std::vector<std::string>>;
+        constexpr size_t size = 1000000;
+        auto s = tests::make_state(size);
+        std::string file = "/tmp/tmp_mapped_file_perf.bin";
+        save(file, std::tie(s.samples, s.rows, s.names));
+
+        bench::run([&](bench::runner& runner) {
+            runner.add(bench::sized("mapped_file/load+sum", size), [&] {
+                auto loaded = load<saved_state>(file);
+                bench::do_not_optimize(compiletime::range_sum(std::get<0>(loaded)));
+            });
+            runner.add(bench::sized("mapped_file/mapped_file+sum", size), [&] {
+                mapped_file<saved_state> mapped{ file };
+                bench::do_not_optimize(compiletime::range_sum(mapped.root().member<0>()));
+            });
+            runner.add(bench::sized("mapped_file/mapped_file+last name", size), [&] {
+                mapped_file<saved_state> mapped{ file };
+                bench::do_not_optimize(mapped.root().member<2>()[size - 1].size());
+            });
+        });
+        unlink(file.c_str());
+    }
+
+}
+
+namespace soa {
+
+    namespace tests {
+
+        void add_benchmarks(bench::runner& runner, size_t count = 64 * 1024) {
+            auto p = make_points(count);
+            // Takes in about a sixth of the points
+            double radius = 0.15 * count;
+            runner.add(bench::sized("soa/sum_x/aos", count), [p] {
+                bench::do_not_optimize(sum_x(p->aos));
+            });
+            runner.add(bench::sized("soa/sum_x/soa", count), [p] {
+                bench::do_not_optimize(sum_x(p->soa));
+            });
+            runner.add(bench::sized("soa/sum_x/soa+range_sum", count), [p] {
+                bench::do_not_optimize(compiletime::range_sum(p->soa.column<0>()));
+            });
+            runner.add(bench::sized("soa/count_within/aos", count), [p, radius] {
+                bench::do_not_optimize(count_within(p->aos, radius));
+            });
+            runner.add(bench::sized("soa/count_within/soa", count), [p, radius] {
+                bench::do_not_optimize(count_within(p->soa, radius));
+            });
+        }
+
+    }
+
+    void soa_perf() {
+        bench::run([](bench::runner& runner) { tests::add_benchmarks(runner, 10000000); });
+    }
+
+}
+
+namespace geometry {
+
+    namespace tests {
+
+        template <typename Point>
+        void add_benchmarks(bench::runner& runner, std::string const& description, size_t count = 16 * 1024) {
+            auto points = std::make_shared<soa::soa_vector<Point>>(random_points<Point>(count, 1));
+            auto out = std::make_shared<std::vector<coordinate_t<Point>>>(points->size());
+            std::mt19937 gen{ 2 };
+            Point query = random_point<Point>(gen, std::make_index_sequence<dimension<Point>::value>{});
+            runner.add(bench::sized("distance/lab1_sequences/" + description, count), [=] {
+                for (size_t i = 0; i < points->size(); ++i) {
+                    (*out)[i] = static_cast<coordinate_t<Point>>(
+                            solutions::lab1_sequences::euclidean_distance(query, static_cast<Point>((*points)[i])));
+                }
+                bench::do_not_optimize(out->data());
+            });
+            runner.add(bench::sized("distance/distances/" + description, count), [=] {
+                distances(query, columns_of(*points), out->data());
+                bench::do_not_optimize(out->data());
+            });
+            runner.add(bench::sized("distance/distances squared/" + description, count), [=] {
+                distances(query, columns_of(*points), out->data(), distance_kind::squared);
+                bench::do_not_optimize(out->data());
+            });
+        }
+
+        void add_benchmarks(bench::runner& runner) {
+            add_benchmarks<std::tuple<float, float, float>>(runner, "float3");
+            add_benchmarks<std::tuple<double, double, double>>(runner, "double3");
+            add_benchmarks<std::tuple<float, float, float, float, float, float, float, float>>(runner, "float8");
+        }
+
+        // The vectorized distances against the one-pair-at-a-time ones, which are computed in double
+        template <typename Point>
+        void print_error(char const* description, size_t count) {
+            auto points = random_points<Point>(count, 1);
+            std::mt19937 gen{ 2 };
+            Point query = random_point<Point>(gen, std::make_index_sequence<dimension<Point>::value>{});
+            std::cout << description << " max relative error: "
+                      << max_relative_error(scalar_distances(query, points), distances(query, points)) << "\n";
+        }
+
+        // The default radius finds about four of the default count of points around a query
+        void add_kd_tree_benchmarks(bench::runner& runner, size_t count = 64 * 1024, float radius = 50.0f) {
+            using point = std::tuple<float, float, float>;
+            auto points = std::make_shared<soa::soa_vector<point>>(random_points<point>(count, 1));
+            auto tree = std::make_shared<kd_tree<point>>(*points);
+            auto queries = std::make_shared<soa::soa_vector<point>>(random_points<point>(1024, 2));
+            auto scratch = std::make_shared<std::vector<float>>();
+            auto next = std::make_shared<size_t>(0);
+            for (size_t k : { size_t{ 1 }, size_t{ 10 } }) {
+                runner.add(bench::sized("kd_tree/nearest/k=" + std::to_string(k), count), [=] {
+                    point q = (*queries)[(*next)++ % queries->size()];
+                    bench::do_not_optimize(tree->nearest(q, k));
+                });
+                runner.add(bench::sized("kd_tree/brute force/k=" + std::to_string(k), count), [=] {
+                    point q = (*queries)[(*next)++ % queries->size()];
+                    bench::do_not_optimize(brute_force_nearest(q, *points, k, *scratch));
+                });
+            }
+            runner.add(bench::sized("kd_tree/within " + std::to_string(static_cast<int>(radius)), count), [=] {
+                point q = (*queries)[(*next)++ % queries->size()];
+                bench::do_not_optimize(tree->within(q, radius));
+            });
+        }
+
+    }
+
+    void distance_perf() {
+        constexpr size_t count = 4 * 1024 * 1024;
+        tests::print_error<std::tuple<float, float, float>>("float3", count);
+        tests::print_error<std::tuple<double, double, double>>("double3", count);
+        bench::run([](bench::runner& runner) {
+            tests::add_benchmarks<std::tuple<float, float, float>>(runner, "float3", count);
+            tests::add_benchmarks<std::tuple<double, double, double>>(runner, "double3", count);
+        });
+    }
+
+    void kd_tree_perf() {
+        using point = std::tuple<float, float, float>;
+        constexpr size_t count = 1000000;
+        auto points = tests::random_points<point>(count, 1);
+        bench::run([&](bench::runner& runner) {
+            for (bool parallel : { false, true }) {
+                runner.add(bench::sized(parallel ? "kd_tree/parallel build" : "kd_tree/sequential build", count), [&, parallel] {
+                    kd_tree<point> tree{ points, parallel };
+                    bench::do_not_optimize(tree);
+                });
+            }
+            tests::add_kd_tree_benchmarks(runner, count, 20.0f);
+        });
+    }
+
+}
+
+namespace solutions {
+
+    namespace tests {
+
+        // Searches for the last of 'count' elements, so that every search reads the whole range
+        template <typename T>
+        void add_search_benchmarks(bench::runner& runner, std::string const& type_name, size_t count) {
+            auto values = std::make_shared<std::vector<T>>(count, T(1));
+            values->back() = T(2);
+            std::string suffix = bench::sized("/vector<" + type_name + ">", count);
+            runner.add("solutions/std::find" + suffix, [values] {
+                T last = T(2);
+                bench::do_not_optimize(last);
+                bench::do_not_optimize(std::find(values->begin(), values->end(), last));
+            });
+            runner.add("solutions/lab3 generic search" + suffix, [values] {
+                T last = T(2);
+                bench::do_not_optimize(last);
+                bench::do_not_optimize(lab3::detail::search_elements(values->begin(), values->end(), last, false_t{}));
+            });
+            runner.add("solutions/lab3::linear_search" + suffix, [values] {
+                T last = T(2);
+                bench::do_not_optimize(last);
+                bench::do_not_optimize(lab3::linear_search(values->begin(), values->end(), last));
+            });
+            runner.add("solutions/lab3::linear_search multithreaded" + suffix, [values] {
+                T last = T(2);
+                bench::do_not_optimize(last);
+                bench::do_not_optimize(lab3::linear_search(values->begin(), values->end(), last, lab3::multithreaded));
+            });
+        }
+
+    }
+
+    void linear_search_perf() {
+        bench::run([](bench::runner& runner) {
+            tests::add_search_benchmarks<int>(runner, "int", 64 * 1024 * 1024 / sizeof(int));
+            tests::add_search_benchmarks<float>(runner, "float", 64 * 1024 * 1024 / sizeof(float));
+            tests::add_search_benchmarks<char>(runner, "char", 64 * 1024 * 1024 / sizeof(char));
+        });
+    }
+
+}
+
+namespace registry {
+
+    namespace tests {
+
+        void add_benchmarks(bench::runner& runner) {
+            using counters = std::make_index_sequence<16>;
+
+            auto fixed = std::make_shared<decltype(make_static_counters(counters{}))>();
+            runner.add("registry/static_registry/16 gets", [fixed] {
+                bump_counters(*fixed, counters{});
+                bench::do_not_optimize(*fixed);
+            });
+
+            auto dynamic = std::make_shared<type_registry>();
+            emplace_counters(*dynamic, counters{});
+            runner.add("registry/type_registry/16 gets", [dynamic] {
+                bump_counters(*dynamic, counters{});
+                bench::clobber_memory();
+            });
+
+            auto hashed = std::make_shared<hashed_registry>();
+            emplace_counters(*hashed, counters{});
+            runner.add("registry/unordered_map<type_index>/16 gets", [hashed] {
+                bump_counters(*hashed, counters{});
+                bench::clobber_memory();
+            });
+        }
+
+    }
+
+    void registry_perf() {
+        bench::run([](bench::runner& runner) { tests::add_benchmarks(runner); });
+    }
+
+}
+
+#endif //TMP_BENCHMARKS_H
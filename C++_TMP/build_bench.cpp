@@ -0,0 +1,431 @@
+// Measures how long the metaprogramming headers take to compile. For every case and size it writes a
+// translation unit, compiles it, and records wall time, peak compiler memory and the compiler's own phase
+// breakdown (-ftime-trace with Clang, -ftime-report with GCC) into a JSON report.
+//
+//   build_bench --compiler c++ --include <dir with the headers> --output report.json
+//               [--work-dir dir] [--sizes 10,100,...] [--cases make_seq,...] [--timeout seconds]
+//               [--memory-limit-mb mb] [--flag f]...
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace buildbench {
+
+    struct options {
+        std::string compiler = "c++";
+        std::string include_dir = ".";
+        std::string work_dir = "build_bench_sources";
+        std::string output = "build_bench.json";
+        std::vector<size_t> sizes{ 10, 100, 500, 1000, 2000, 5000 };
+        std::vector<std::string> cases;
+        std::vector<std::string> flags;
+        unsigned timeout_seconds = 600;
+        size_t memory_limit_mb = 4096;
+    };
+
+    struct measurement {
+        std::string case_name;
+        size_t size = 0;
+        std::string status;
+        int exit_code = 0;
+        double wall_ms = 0;
+        long peak_rss_kb = 0;
+        std::map<std::string, double> breakdown_ms;
+    };
+
+    // Source generators
+
+    std::string padded_types() {
+        return "template <size_t I> struct padded { char data[I % 13 + 1]; };\n";
+    }
+
+    std::string type_list(size_t n) {
+        std::ostringstream out;
+        for (size_t i = 0; i < n; ++i) {
+            out << (i == 0 ? "" : ", ") << "padded<" << i << ">";
+        }
+        return out.str();
+    }
+
+    // n elements split into tuples of at most ten ints each
+    std::string tuple_arguments(size_t n) {
+        std::ostringstream out;
+        for (size_t first = 0; first < n; first += 10) {
+            out << (first == 0 ? "" : ",\n        ") << "std::make_tuple(";
+            for (size_t i = first; i < std::min(n, first + 10); ++i) {
+                out << (i == first ? "" : ", ") << i;
+            }
+            out << ")";
+        }
+        return out.str();
+    }
+
+    std::string baseline_source(size_t) {
+        return "#include \"sequences.h\"\n"
+               "#include \"compile_time_computation.h\"\n"
+               "#include \"solutions.h\"\n"
+               "#include \"tuple_cat.h\"\n"
+               "int main() {}\n";
+    }
+
+    std::string make_seq_source(size_t n) {
+        std::ostringstream out;
+        out << "#include \"sequences.h\"\n"
+            << "static_assert(sequences::make_seq<" << n << ">::type::length == " << n + 1 << ", \"\");\n"
+            << "int main() {}\n";
+        return out.str();
+    }
+
+    std::string largest_t_source(size_t n) {
+        std::ostringstream out;
+        out << "#include \"compile_time_computation.h\"\n"
+            << padded_types()
+            << "using largest = compiletime::detail::largest_t<" << type_list(n) << ">::type;\n"
+            << "static_assert(sizeof(largest) == " << std::min<size_t>(n, 13) << ", \"\");\n"
+            << "int main() {}\n";
+        return out.str();
+    }
+
+    std::string lab2_get_source(size_t n) {
+        std::ostringstream out;
+        out << "#include \"solutions.h\"\n"
+            << padded_types()
+            << "int main() {\n"
+            << "    std::tuple<" << type_list(n) << "> tup;\n"
+            << "    return solutions::lab2::get<padded<" << n - 1 << ">>(tup).data[0];\n"
+            << "}\n";
+        return out.str();
+    }
+
+    std::string tuple_cat_source(std::string const& implementation, size_t n) {
+        std::ostringstream out;
+        out << "#include \"tuple_cat.h\"\n"
+            << "int main() {\n"
+            << "    auto result = tupcat::" << implementation << "::tuple_cat(\n        " << tuple_arguments(n) << ");\n"
+            << "    return std::get<" << n - 1 << ">(result);\n"
+            << "}\n";
+        return out.str();
+    }
+
+    struct bench_case {
+        std::string name;
+        std::function<std::string(size_t)> generate;
+        bool sized;
+    };
+
+    std::vector<bench_case> all_cases() {
+        return {
+            { "baseline", baseline_source, false },
+            { "make_seq", make_seq_source, true },
+            { "largest_t", largest_t_source, true },
+            { "lab2_get", lab2_get_source, true },
+            { "tuple_cat_direct", [](size_t n) { return tuple_cat_source("direct", n); }, true },
+            { "tuple_cat_2d", [](size_t n) { return tuple_cat_source("twodimensional", n); }, true },
+        };
+    }
+
+    // Compiler interaction
+
+    std::string run_and_capture(std::string const& command) {
+        std::string output;
+        FILE* pipe = popen(command.c_str(), "r");
+        if (pipe == nullptr)
+            return output;
+        char buffer[256];
+        while (std::fgets(buffer, sizeof(buffer), pipe) != nullptr) {
+            output += buffer;
+        }
+        pclose(pipe);
+        return output;
+    }
+
+    bool is_clang(std::string const& compiler) {
+        return run_and_capture("'" + compiler + "' --version 2>/dev/null").find("clang") != std::string::npos;
+    }
+
+    std::string compiler_version(std::string const& compiler) {
+        std::string version = run_and_capture("'" + compiler + "' --version 2>/dev/null");
+        return version.substr(0, version.find('\n'));
+    }
+
+    std::string read_file(std::string const& path) {
+        std::ifstream in{ path };
+        std::ostringstream contents;
+        contents << in.rdbuf();
+        return contents.str();
+    }
+
+    // Clang's trace ends with "Total <event>" entries that sum up each kind of event, e.g. InstantiateClass:
+    // {"pid":1,"tid":0,"ph":"X","ts":0,"dur":1234,"name":"Total InstantiateClass","args":{...}}
+    void parse_time_trace(std::string const& trace, std::map<std::string, double>& breakdown) {
+        std::string const marker = "\"name\":\"Total ";
+        for (size_t pos = trace.find(marker); pos != std::string::npos; pos = trace.find(marker, pos + 1)) {
+            size_t name_begin = pos + marker.size();
+            size_t name_end = trace.find('"', name_begin);
+            size_t event_begin = trace.rfind("{\"pid\"", pos);
+            if (name_end == std::string::npos || event_begin == std::string::npos)
+                continue;
+            size_t dur = trace.find("\"dur\":", event_begin);
+            if (dur == std::string::npos || dur > pos)
+                continue;
+            breakdown[trace.substr(name_begin, name_end - name_begin)] = std::strtod(trace.c_str() + dur + 6, nullptr) / 1000.0;
+        }
+    }
+
+    // GCC prints " phase name : usr (pct) sys (pct) wall (pct) mem (pct)" lines; keep the wall column
+    void parse_time_report(std::string const& report, std::map<std::string, double>& breakdown) {
+        std::istringstream lines{ report };
+        for (std::string line; std::getline(lines, line); ) {
+            size_t colon = line.find(':');
+            if (colon == std::string::npos || line.find('(') == std::string::npos)
+                continue;
+            std::string name = line.substr(0, colon);
+            name.erase(0, name.find_first_not_of(' '));
+            name.erase(name.find_last_not_of(' ') + 1);
+            if (name.empty() || name.find("Time variable") != std::string::npos)
+                continue;
+
+            char const* p = line.c_str() + colon + 1;
+            double columns[3];
+            int found = 0;
+            for (; found < 3; ++found) {
+                char* end;
+                columns[found] = std::strtod(p, &end);
+                if (end == p)
+                    break;
+                p = std::strchr(end, ')');
+                if (p == nullptr)
+                    break;
+                ++p;
+            }
+            if (found == 3) {
+                breakdown[name] = columns[2] * 1000.0;
+            }
+        }
+    }
+
+    // Runs the compiler directly (no shell), polling so a runaway compile can be killed at the deadline.
+    // wait4 reports the largest RSS of the driver and the compiler processes it waited for.
+    measurement compile(options const& opts, bool clang, std::string const& source, std::string const& object,
+                        std::string const& log) {
+        measurement result;
+        std::vector<std::string> args{ opts.compiler };
+        args.insert(args.end(), opts.flags.begin(), opts.flags.end());
+        args.insert(args.end(), { "-I", opts.include_dir, "-c", source, "-o", object });
+        args.push_back(clang ? "-ftime-trace" : "-ftime-report");
+
+        std::vector<char*> argv;
+        for (auto& arg : args) {
+            argv.push_back(&arg[0]);
+        }
+        argv.push_back(nullptr);
+
+        auto start = std::chrono::steady_clock::now();
+        pid_t pid = fork();
+        if (pid < 0)
+            throw std::runtime_error(std::string("fork failed: ") + std::strerror(errno));
+        if (pid > 0) {
+            setpgid(pid, pid);
+        }
+        if (pid == 0) {
+            // A process group of its own, so a timeout kills the compiler proper and not just the driver
+            setpgid(0, 0);
+            // Runaway instantiations fail with "out of memory" instead of taking the machine down
+            rlimit limit{};
+            limit.rlim_cur = limit.rlim_max = static_cast<rlim_t>(opts.memory_limit_mb) << 20;
+            setrlimit(RLIMIT_AS, &limit);
+            FILE* out = std::freopen(log.c_str(), "w", stderr);
+            if (out != nullptr) {
+                dup2(fileno(stderr), fileno(stdout));
+            }
+            execvp(argv[0], argv.data());
+            _exit(127);
+        }
+
+        int status = 0;
+        rusage usage{};
+        auto deadline = start + std::chrono::seconds(opts.timeout_seconds);
+        bool timed_out = false;
+        for (;;) {
+            pid_t done = wait4(pid, &status, WNOHANG, &usage);
+            if (done == pid)
+                break;
+            if (done < 0 && errno != EINTR)
+                throw std::runtime_error(std::string("wait4 failed: ") + std::strerror(errno));
+            if (!timed_out && std::chrono::steady_clock::now() > deadline) {
+                kill(-pid, SIGKILL);
+                timed_out = true;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        result.wall_ms = std::chrono::duration<double, std::milli>(end - start).count();
+        // A killed compiler is never waited for by its driver, so its memory isn't in the driver's usage
+        result.peak_rss_kb = timed_out ? 0 : usage.ru_maxrss;
+        result.exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+        result.status = timed_out ? "timeout" : (result.exit_code == 0 ? "ok" : "failed");
+
+        if (result.status == "ok") {
+            if (clang) {
+                std::string trace = object.substr(0, object.rfind('.')) + ".json";
+                parse_time_trace(read_file(trace), result.breakdown_ms);
+            } else {
+                parse_time_report(read_file(log), result.breakdown_ms);
+            }
+        }
+        return result;
+    }
+
+    // Report
+
+    std::string json_string(std::string const& s) {
+        std::string out = "\"";
+        for (char c : s) {
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        char escaped[8];
+                        std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                        out += escaped;
+                    } else {
+                        out += c;
+                    }
+            }
+        }
+        return out + "\"";
+    }
+
+    void write_report(options const& opts, bool clang, std::vector<measurement> const& results) {
+        std::ofstream out{ opts.output };
+        if (!out)
+            throw std::runtime_error("can't write " + opts.output);
+
+        out << "{\n  \"compiler\": " << json_string(compiler_version(opts.compiler)) << ",\n  \"flags\": [";
+        for (size_t i = 0; i < opts.flags.size(); ++i) {
+            out << (i == 0 ? "" : ", ") << json_string(opts.flags[i]);
+        }
+        out << "],\n  \"breakdown_source\": " << json_string(clang ? "ftime-trace" : "ftime-report")
+            << ",\n  \"results\": [\n";
+        for (size_t i = 0; i < results.size(); ++i) {
+            auto const& r = results[i];
+            out << "    {\"case\": " << json_string(r.case_name) << ", \"size\": " << r.size
+                << ", \"status\": " << json_string(r.status) << ", \"exit_code\": " << r.exit_code
+                << ", \"wall_ms\": " << r.wall_ms << ", \"peak_rss_kb\": " << r.peak_rss_kb << ", \"breakdown_ms\": {";
+            bool first = true;
+            for (auto const& phase : r.breakdown_ms) {
+                out << (first ? "" : ", ") << json_string(phase.first) << ": " << phase.second;
+                first = false;
+            }
+            out << "}}" << (i + 1 == results.size() ? "" : ",") << "\n";
+        }
+        out << "  ]\n}\n";
+    }
+
+    std::vector<std::string> split(std::string const& list) {
+        std::vector<std::string> items;
+        std::istringstream in{ list };
+        for (std::string item; std::getline(in, item, ','); ) {
+            if (!item.empty()) {
+                items.push_back(item);
+            }
+        }
+        return items;
+    }
+
+    options parse_options(int argc, char* argv[]) {
+        options opts;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc)
+                    throw std::invalid_argument("missing value for " + arg);
+                return argv[++i];
+            };
+            if (arg == "--compiler") opts.compiler = value();
+            else if (arg == "--include") opts.include_dir = value();
+            else if (arg == "--work-dir") opts.work_dir = value();
+            else if (arg == "--output") opts.output = value();
+            else if (arg == "--timeout") opts.timeout_seconds = static_cast<unsigned>(std::stoul(value()));
+            else if (arg == "--memory-limit-mb") opts.memory_limit_mb = std::stoul(value());
+            else if (arg == "--flag") opts.flags.push_back(value());
+            else if (arg == "--cases") opts.cases = split(value());
+            else if (arg == "--sizes") {
+                opts.sizes.clear();
+                for (auto const& size : split(value())) {
+                    opts.sizes.push_back(std::stoul(size));
+                }
+            }
+            else throw std::invalid_argument("unknown option " + arg);
+        }
+        if (opts.flags.empty()) {
+            opts.flags.push_back("-std=c++14");
+        }
+        return opts;
+    }
+
+    int run(options opts) {
+        bool clang = is_clang(opts.compiler);
+        if (mkdir(opts.work_dir.c_str(), 0755) != 0 && errno != EEXIST)
+            throw std::runtime_error("can't create " + opts.work_dir + ": " + std::strerror(errno));
+
+        // The largest sizes need deeper recursion than the default limit for the linear algorithms
+        size_t max_size = *std::max_element(opts.sizes.begin(), opts.sizes.end());
+        opts.flags.push_back("-ftemplate-depth=" + std::to_string(std::max<size_t>(900, 2 * max_size + 100)));
+
+        std::vector<measurement> results;
+        for (auto const& c : all_cases()) {
+            if (!opts.cases.empty() && std::find(opts.cases.begin(), opts.cases.end(), c.name) == opts.cases.end())
+                continue;
+            std::vector<size_t> sizes = c.sized ? opts.sizes : std::vector<size_t>{ 0 };
+            for (size_t size : sizes) {
+                std::string stem = opts.work_dir + "/" + c.name + "_" + std::to_string(size);
+                {
+                    std::ofstream source{ stem + ".cpp" };
+                    source << c.generate(size);
+                }
+                measurement m = compile(opts, clang, stem + ".cpp", stem + ".o", stem + ".log");
+                m.case_name = c.name;
+                m.size = size;
+                std::cout << "[" << c.name << " " << size << "] " << m.status << ", " << m.wall_ms << " ms, "
+                          << m.peak_rss_kb << " KB peak\n" << std::flush;
+                results.push_back(std::move(m));
+            }
+        }
+        write_report(opts, clang, results);
+        std::cout << "report written to " << opts.output << '\n';
+        return 0;
+    }
+
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        return buildbench::run(buildbench::parse_options(argc, argv));
+    } catch (std::exception const& e) {
+        std::cerr << "build_bench: " << e.what() << '\n';
+        return 1;
+    }
+}
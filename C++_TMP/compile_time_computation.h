@@ -12,6 +12,7 @@
 #include <initializer_list>
 
 #include "common.h"
+#include "type_lists.h"
 #include "variadics.h"
 
 namespace compiletime {
@@ -25,6 +26,12 @@ namespace compiletime {
             template <size_t N>
             constexpr cstr(char const(&str)[N]) : start_(str), length_(N) {
             }
+            constexpr size_t size() const {
+                return length_ - 1; /* null terminator */
+            }
+            constexpr char operator[](size_t i) const {
+                return start_[i];
+            }
             constexpr bool is_valid_pattern() const {
                 for (size_t i = 0; i < length_ - 1 /* null terminator */; ++i) {
                     if (start_[i] >= 'A' && start_[i] <= 'Z')
@@ -33,7 +40,10 @@ namespace compiletime {
                     if (start_[i] >= 'a' && start_[i] <= 'z')
                         continue;
 
-                    if (start_[i] == '*' || start_[i] == '?')
+                    if (start_[i] >= '0' && start_[i] <= '9')
+                        continue;
+
+                    if (start_[i] == '*' || start_[i] == '?' || start_[i] == '.' || start_[i] == '_' || start_[i] == '-')
                         continue;
 
                     return false;
@@ -50,17 +60,33 @@ namespace compiletime {
             }
         };
 
-        template <typename...> struct largest_t;
+        // Offsets and lengths of the pieces of a string between occurrences of a separator character;
+        // there is always one more piece than there are separators.
+        template <size_t N>
+        struct cstr_segments {
+            size_t offset[N];
+            size_t length[N];
+        };
 
-        template <typename T> struct largest_t<T> : is<T> {};
+        template <size_t N>
+        constexpr cstr_segments<N> split(cstr str, char separator) {
+            cstr_segments<N> segments{};
+            size_t segment = 0, start = 0;
+            for (size_t i = 0; i < str.size(); ++i) {
+                if (str[i] == separator) {
+                    segments.offset[segment] = start;
+                    segments.length[segment] = i - start;
+                    ++segment;
+                    start = i + 1;
+                }
+            }
+            segments.offset[segment] = start;
+            segments.length[segment] = str.size() - start;
+            return segments;
+        }
 
-        template <typename T1, typename T2, typename... Rest>
-        struct largest_t<T1, T2, Rest...> {
-            using type = typename select_t<(sizeof(T1) < sizeof(T2)),
-                    typename largest_t<T2, Rest...>::type,
-                    typename largest_t<T1, Rest...>::type
-                    >::type;
-        };
+        template <typename... Types>
+        struct largest_t : typelists::max_by_size<Types...> {};
 
         void largest_test() {
             static_assert(same_v<typename largest_t<int>::type, int>, "");
@@ -68,16 +94,11 @@ namespace compiletime {
             static_assert(same_v<typename largest_t<char, long long, long>::type, long long>, "");
         }
 
-        template <template <class> class>
+        template <template <class> class Op, typename... Types>
         constexpr bool and_f() {
-            return true;
+            return typelists::all<Op, Types...>::value;
         }
 
-        template <template <class> class Op, typename T, typename... Types>
-        constexpr bool and_f() {
-            return Op<T>::value && and_f<Op, Types...>();
-        };
-
         template <typename T> struct size_smaller_than_five { constexpr static bool value = sizeof(T) < 5; };
 
         void andf_test() {
@@ -88,18 +109,13 @@ namespace compiletime {
         }
     }
 
-#define FIND_FILES(pattern) \
-    static_assert(compiletime::detail::cstr{ pattern }.is_valid_pattern(), "pattern contains invalid characters"); \
-    compiletime::find_files(pattern);
-
-    void find_files(std::string const& pattern) {
-        if (!std::all_of(pattern.begin(), pattern.end(), [](char c) {
-            return isalnum(c) || c == '*' || c == '?';
-        })) {
-            throw std::invalid_argument("pattern contains invalid characters");
-        }
-        // The actual work would go here
-    }
+    // Turns a string literal into a value whose type carries the literal, as a static str() member,
+    // so templates can take it apart at compile time.
+#define COMPILE_TIME_STRING(literal) \
+    [] { \
+        struct compile_time_string { static constexpr decltype(auto) str() { return literal; } }; \
+        return compile_time_string{}; \
+    }()
 
     template <typename... Types, typename = allow_if_t<detail::and_f<integral_t, Types...>()>>
     auto varmax(Types... args) {
@@ -0,0 +1,381 @@
+#ifndef TMP_DIRECTORY_CACHE_H
+#define TMP_DIRECTORY_CACHE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "file_search.h"
+
+namespace compiletime {
+
+    // Keeps the listings of the directories find_files has read, so that repeated searches over the same tree
+    // only read the directories that changed since. Each cached directory has an inotify watch; the events that
+    // arrived since the last search are applied before the next one starts, dropping the listings they affect.
+    // Directories that can't be watched (e.g. when out of inotify watches) are read every time.
+    //
+    // Aliases of one directory (e.g. a path through a symbolic link, or "a" and "a/.") share its inotify watch;
+    // the watch is removed once none of them is cached.
+    //
+    // The listings can be saved to a snapshot file and loaded in another process. A loaded listing is used
+    // only if the directory's modification time still matches the one recorded when it was read.
+    class directory_cache {
+    public:
+        struct statistics {
+            unsigned long long hits;
+            unsigned long long misses;
+            unsigned long long invalidations;
+        };
+
+    private:
+        constexpr static std::uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                                                    IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+        constexpr static char SNAPSHOT_MAGIC[8] = { 'T', 'M', 'P', 'D', 'I', 'R', 'C', '2' };
+
+        struct entry {
+            std::uint32_t offset; // into listing::names
+            std::uint16_t length; // names are at most 255 bytes on Linux
+            std::uint8_t is_directory;
+        };
+
+        struct listing {
+            std::string names;
+            std::vector<entry> entries;
+            std::int64_t mtime_sec;
+            std::int64_t mtime_nsec;
+        };
+
+        struct directory {
+            std::shared_ptr<listing const> contents;
+            int watch = -1;
+            bool validated = true; // false for listings loaded from a snapshot until their mtime is checked
+        };
+
+        int inotify_fd_;
+        mutable std::mutex lock_;
+        std::unordered_map<std::string, directory> directories_;
+        // The cached paths each watch stands for
+        std::unordered_map<int, std::vector<std::string>> watches_;
+
+        std::atomic<unsigned long long> hits_{ 0 };
+        std::atomic<unsigned long long> misses_{ 0 };
+        std::atomic<unsigned long long> invalidations_{ 0 };
+
+        static bool same_mtime(struct stat const& st, listing const& contents) {
+            return st.st_mtim.tv_sec == contents.mtime_sec && st.st_mtim.tv_nsec == contents.mtime_nsec;
+        }
+
+        // Must be called with the lock held
+        void watch(int watch, std::string const& path) {
+            auto& paths = watches_[watch];
+            if (std::find(paths.begin(), paths.end(), path) == paths.end()) {
+                paths.push_back(path);
+            }
+        }
+
+        // Removes the watch once no other path depends on it. Must be called with the lock held.
+        void unwatch(int watch, std::string const& path) {
+            auto it = watches_.find(watch);
+            if (it == watches_.end())
+                return;
+            it->second.erase(std::remove(it->second.begin(), it->second.end(), path), it->second.end());
+            if (it->second.empty()) {
+                ::inotify_rm_watch(inotify_fd_, watch);
+                watches_.erase(it);
+            }
+        }
+
+        // Must be called with the lock held
+        void forget(std::unordered_map<std::string, directory>::iterator it) {
+            if (it->second.watch != -1) {
+                unwatch(it->second.watch, it->first);
+            }
+            directories_.erase(it);
+        }
+
+        // Drops a directory and everything cached below it, e.g. when it was moved away or deleted.
+        // Must be called with the lock held.
+        void forget_tree(std::string const& path) {
+            std::string prefix = path + '/';
+            for (auto it = directories_.begin(); it != directories_.end();) {
+                auto current = it++;
+                if (current->first == path || current->first.compare(0, prefix.size(), prefix) == 0) {
+                    forget(current);
+                    ++invalidations_;
+                }
+            }
+        }
+
+        // Returns the cached listing if it is still current, otherwise null
+        std::shared_ptr<listing const> cached(std::string const& path) {
+            std::unique_lock<std::mutex> guard{ lock_ };
+            auto it = directories_.find(path);
+            if (it == directories_.end() || !it->second.contents)
+                return nullptr;
+            if (it->second.validated)
+                return it->second.contents;
+
+            // Loaded from a snapshot: watch the directory first so nothing slips in between, then check it
+            // hasn't changed since the snapshot was taken
+            int watch = ::inotify_add_watch(inotify_fd_, path.c_str(), WATCH_MASK);
+            struct stat st;
+            if (watch != -1) {
+                it->second.watch = watch;
+                this->watch(watch, path);
+            }
+            if (watch == -1 || ::stat(path.c_str(), &st) != 0 || !same_mtime(st, *it->second.contents)) {
+                it->second.contents.reset();
+                ++invalidations_;
+                return nullptr;
+            }
+            it->second.validated = true;
+            return it->second.contents;
+        }
+
+        void store(std::string const& path, int watch, std::shared_ptr<listing const> contents) {
+            std::lock_guard<std::mutex> guard{ lock_ };
+            directory& dir = directories_[path];
+            if (dir.watch != -1 && dir.watch != watch) {
+                unwatch(dir.watch, path);
+            }
+            dir.contents = std::move(contents);
+            dir.watch = watch;
+            dir.validated = true;
+            this->watch(watch, path);
+        }
+
+        template <typename T>
+        static void write_raw(std::ofstream& out, T const& value) {
+            out.write(reinterpret_cast<char const*>(&value), sizeof(value));
+        }
+
+        template <typename T>
+        static void read_raw(std::ifstream& in, T& value) {
+            if (!in.read(reinterpret_cast<char*>(&value), sizeof(value)))
+                throw std::runtime_error("truncated directory cache snapshot");
+        }
+
+    public:
+        directory_cache() : inotify_fd_{ ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC) } {
+            if (inotify_fd_ == -1) {
+                throw std::system_error(errno, std::system_category(), "inotify_init1");
+            }
+        }
+
+        directory_cache(directory_cache const&) = delete;
+        directory_cache& operator=(directory_cache const&) = delete;
+
+        ~directory_cache() {
+            ::close(inotify_fd_); // Removes all the watches
+        }
+
+        // Applies the inotify events that arrived since the last call; find_files calls this before each search
+        void process_events() {
+            alignas(inotify_event) char buffer[64 * 1024];
+            std::lock_guard<std::mutex> guard{ lock_ };
+            for (;;) {
+                ssize_t bytes = ::read(inotify_fd_, buffer, sizeof(buffer));
+                if (bytes <= 0)
+                    return; // EAGAIN: no more events
+
+                for (ssize_t offset = 0; offset < bytes;) {
+                    auto event = reinterpret_cast<inotify_event const*>(buffer + offset);
+                    offset += sizeof(inotify_event) + event->len;
+
+                    if (event->mask & IN_Q_OVERFLOW) {
+                        // Events were lost, so nothing can be trusted any more
+                        invalidations_ += directories_.size();
+                        directories_.clear();
+                        watches_.clear();
+                        ::close(inotify_fd_);
+                        inotify_fd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+                        if (inotify_fd_ == -1) {
+                            throw std::system_error(errno, std::system_category(), "inotify_init1");
+                        }
+                        return;
+                    }
+
+                    auto watch = watches_.find(event->wd);
+                    if (watch == watches_.end())
+                        continue; // Already forgotten, e.g. IN_IGNORED after inotify_rm_watch
+                    // Copied, since forgetting a tree changes the watches
+                    std::vector<std::string> paths = watch->second;
+
+                    for (auto const& path : paths) {
+                        if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                            forget_tree(path);
+                            continue;
+                        }
+                        if ((event->mask & IN_ISDIR) && (event->mask & (IN_DELETE | IN_MOVED_FROM))) {
+                            forget_tree(path + '/' + event->name);
+                        }
+                        auto dir = directories_.find(path);
+                        if (dir != directories_.end() && dir->second.contents) {
+                            dir->second.contents.reset();
+                            ++invalidations_;
+                        }
+                    }
+                }
+            }
+        }
+
+        // The lister interface used by the directory walk in find_files
+        template <typename OnEntry>
+        void operator()(std::string const& path, std::vector<char>& buffer, OnEntry&& on_entry) {
+            if (auto contents = cached(path)) {
+                ++hits_;
+                for (auto const& e : contents->entries) {
+                    on_entry(contents->names.data() + e.offset, e.length, e.is_directory != 0);
+                }
+                return;
+            }
+            ++misses_;
+
+            // Watch before reading, so a change made while the directory is being read still invalidates it
+            int watch = ::inotify_add_watch(inotify_fd_, path.c_str(), WATCH_MASK);
+            detail::file_descriptor dir{ detail::open_directory(path) };
+            struct stat st;
+            if (dir.fd == -1 || ::fstat(dir.fd, &st) != 0) {
+                std::lock_guard<std::mutex> guard{ lock_ };
+                if (watch != -1 && watches_.find(watch) == watches_.end()) {
+                    ::inotify_rm_watch(inotify_fd_, watch);
+                }
+                return;
+            }
+
+            auto contents = std::make_shared<listing>();
+            contents->mtime_sec = st.st_mtim.tv_sec;
+            contents->mtime_nsec = st.st_mtim.tv_nsec;
+            detail::list_directory(dir.fd, buffer, [&](char const* name, size_t length, bool is_directory) {
+                contents->entries.push_back(entry{ static_cast<std::uint32_t>(contents->names.size()),
+                                                   static_cast<std::uint16_t>(length),
+                                                   static_cast<std::uint8_t>(is_directory) });
+                contents->names.append(name, length);
+                on_entry(name, length, is_directory);
+            });
+
+            if (watch != -1) {
+                store(path, watch, std::move(contents));
+            }
+        }
+
+        statistics stats() const {
+            return statistics{ hits_.load(), misses_.load(), invalidations_.load() };
+        }
+
+        // The number of directories with a current listing
+        size_t size() const {
+            std::lock_guard<std::mutex> guard{ lock_ };
+            size_t count = 0;
+            for (auto const& dir : directories_) {
+                count += dir.second.contents != nullptr;
+            }
+            return count;
+        }
+
+        void save(std::string const& file) const {
+            std::ofstream out{ file, std::ios::binary | std::ios::trunc };
+            if (!out)
+                throw std::runtime_error("can't write directory cache snapshot " + file);
+
+            std::lock_guard<std::mutex> guard{ lock_ };
+            out.write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+            for (auto const& dir : directories_) {
+                listing const* contents = dir.second.contents.get();
+                if (contents == nullptr)
+                    continue;
+                write_raw(out, static_cast<std::uint32_t>(dir.first.size()));
+                out.write(dir.first.data(), dir.first.size());
+                write_raw(out, contents->mtime_sec);
+                write_raw(out, contents->mtime_nsec);
+                write_raw(out, static_cast<std::uint32_t>(contents->names.size()));
+                out.write(contents->names.data(), contents->names.size());
+                write_raw(out, static_cast<std::uint32_t>(contents->entries.size()));
+                // Field by field, so the file doesn't depend on (or leak) the struct's padding
+                for (auto const& e : contents->entries) {
+                    write_raw(out, e.offset);
+                    write_raw(out, e.length);
+                    write_raw(out, e.is_directory);
+                }
+            }
+            if (!out)
+                throw std::runtime_error("can't write directory cache snapshot " + file);
+        }
+
+        // Adds the listings from a snapshot for directories that aren't cached yet
+        void load(std::string const& file) {
+            std::ifstream in{ file, std::ios::binary };
+            if (!in)
+                throw std::runtime_error("can't read directory cache snapshot " + file);
+
+            char magic[sizeof(SNAPSHOT_MAGIC)];
+            if (!in.read(magic, sizeof(magic)) || !std::equal(std::begin(magic), std::end(magic), SNAPSHOT_MAGIC))
+                throw std::runtime_error(file + " is not a directory cache snapshot");
+
+            std::lock_guard<std::mutex> guard{ lock_ };
+            std::uint32_t path_size;
+            while (in.read(reinterpret_cast<char*>(&path_size), sizeof(path_size))) {
+                std::string path(path_size, '\0');
+                auto contents = std::make_shared<listing>();
+                std::uint32_t names_size, entry_count;
+
+                if (!in.read(&path[0], path_size))
+                    throw std::runtime_error("truncated directory cache snapshot");
+                read_raw(in, contents->mtime_sec);
+                read_raw(in, contents->mtime_nsec);
+                read_raw(in, names_size);
+                contents->names.resize(names_size);
+                if (!in.read(&contents->names[0], names_size))
+                    throw std::runtime_error("truncated directory cache snapshot");
+                read_raw(in, entry_count);
+                for (std::uint32_t i = 0; i < entry_count; ++i) {
+                    entry e;
+                    read_raw(in, e.offset);
+                    read_raw(in, e.length);
+                    read_raw(in, e.is_directory);
+                    if (e.offset > names_size || e.length > names_size - e.offset)
+                        throw std::runtime_error("corrupt directory cache snapshot");
+                    contents->entries.push_back(e);
+                }
+
+                directory& dir = directories_[path];
+                if (!dir.contents) {
+                    dir.contents = std::move(contents);
+                    dir.validated = false;
+                }
+            }
+        }
+    };
+
+    constexpr char directory_cache::SNAPSHOT_MAGIC[8];
+
+    // find_files that reads directories through the cache
+    template <typename Callback>
+    void find_files(std::string const& pattern, std::string const& root, Callback callback, directory_cache& cache) {
+        cache.process_events();
+        detail::walk(root, cache, runtime_glob{ pattern }, callback, parallel::thread_pool::shared());
+    }
+
+    template <typename Pattern, typename Callback>
+    void find_files(static_glob<Pattern> const& glob, std::string const& root, Callback callback,
+                    directory_cache& cache) {
+        cache.process_events();
+        detail::walk(root, cache, glob, callback, parallel::thread_pool::shared());
+    }
+
+}
+
+#endif //TMP_DIRECTORY_CACHE_H
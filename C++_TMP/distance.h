@@ -0,0 +1,257 @@
+#ifndef TMP_DISTANCE_H
+#define TMP_DISTANCE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "range_reductions.h"
+#include "soa.h"
+#include "solutions.h"
+#include "thread_pool.h"
+#include "type_lists.h"
+
+// Distances from one query point to many points at once. Points are tuples whose members all have the same
+// floating-point type; the number of members is the dimension, known at compile time. The points are read
+// from a soa::soa_vector (or any D columns of coordinates), a register's worth of points at a time.
+namespace geometry {
+
+    template <typename Point>
+    struct dimension : std::integral_constant<size_t, std::tuple_size<Point>::value> {};
+
+    // The coordinate type of a point, which every member must share
+    template <typename Point>
+    struct coordinate;
+
+    template <typename T, typename... Ts>
+    struct coordinate<std::tuple<T, Ts...>> {
+        static_assert(typelists::count<T, Ts...>::value == sizeof...(Ts), "all coordinates must have the same type");
+        static_assert(std::is_floating_point<T>::value, "coordinates must be float or double");
+        using type = T;
+    };
+
+    template <typename Point>
+    using coordinate_t = typename coordinate<Point>::type;
+
+    enum class distance_kind { euclidean, squared };
+
+    // D coordinate arrays of 'size' points each
+    template <typename T, size_t D>
+    struct point_columns {
+        T const* columns[D];
+        size_t size;
+    };
+
+    namespace detail {
+
+        template <typename... Ts, size_t... Ds>
+        point_columns<coordinate_t<std::tuple<Ts...>>, sizeof...(Ts)>
+        columns_of(soa::soa_vector<std::tuple<Ts...>> const& points, std::index_sequence<Ds...>) {
+            return { { points.template column<Ds>().data()... }, points.size() };
+        }
+
+    }
+
+    template <typename... Ts>
+    point_columns<coordinate_t<std::tuple<Ts...>>, sizeof...(Ts)> columns_of(soa::soa_vector<std::tuple<Ts...>> const& points) {
+        return detail::columns_of(points, std::index_sequence_for<Ts...>{});
+    }
+
+    // Ranges of at least this many points are split across the shared thread pool
+    constexpr size_t PARALLEL_DISTANCE_THRESHOLD = 64 * 1024;
+
+    namespace detail {
+
+        using compiletime::detail::simd;
+        using compiletime::detail::load;
+
+        template <typename T>
+        void store(T* p, typename simd<T>::type v) {
+            std::memcpy(p, &v, sizeof(v));
+        }
+
+        template <typename T>
+        typename simd<T>::type broadcast(T value) {
+            typename simd<T>::type v = {};
+            return v + value;
+        }
+
+        // a * b + c, rounded once where the target has fused multiply-add (e.g. with TMP_NATIVE_ARCH)
+        template <typename V>
+        V multiply_add(V a, V b, V c) {
+            return a * b + c;
+        }
+
+#if defined(__FMA__) && defined(__AVX__)
+        template <>
+        simd<float>::type multiply_add(simd<float>::type a, simd<float>::type b, simd<float>::type c) {
+            return _mm256_fmadd_ps(a, b, c);
+        }
+
+        template <>
+        simd<double>::type multiply_add(simd<double>::type a, simd<double>::type b, simd<double>::type c) {
+            return _mm256_fmadd_pd(a, b, c);
+        }
+#endif
+
+        template <typename V>
+        V square_root(V v) {
+            for (size_t lane = 0; lane < sizeof(V) / sizeof(v[0]); ++lane) {
+                v[lane] = std::sqrt(v[lane]);
+            }
+            return v;
+        }
+
+#if defined(__AVX__)
+        template <>
+        simd<float>::type square_root(simd<float>::type v) {
+            return _mm256_sqrt_ps(v);
+        }
+
+        template <>
+        simd<double>::type square_root(simd<double>::type v) {
+            return _mm256_sqrt_pd(v);
+        }
+#elif defined(__SSE2__)
+        template <>
+        simd<float>::type square_root(simd<float>::type v) {
+            return _mm_sqrt_ps(v);
+        }
+
+        template <>
+        simd<double>::type square_root(simd<double>::type v) {
+            return _mm_sqrt_pd(v);
+        }
+#endif
+
+        template <typename V>
+        V add_square(V sum, V delta) {
+            return multiply_add(delta, delta, sum);
+        }
+
+        // Points [first, last) of the columns. The dimensions are expanded inline, so each block of points
+        // costs D loads and D multiply-adds with no loop over the dimension; two blocks are in flight at once.
+        template <bool Squared, typename T, size_t D, size_t... Ds>
+        void distance_kernel(T const (&query)[D], point_columns<T, D> const& points, size_t first, size_t last,
+                             T* out, std::index_sequence<Ds...>) {
+            using vec = typename simd<T>::type;
+            constexpr size_t L = simd<T>::LANES;
+            vec const q[D] = { broadcast(query[Ds])... };
+            size_t i = first;
+            for (; i + 2 * L <= last; i += 2 * L) {
+                vec sum0 = {}, sum1 = {};
+                (void)std::initializer_list<int>{ (
+                        sum0 = add_square(sum0, load(points.columns[Ds] + i) - q[Ds]),
+                        sum1 = add_square(sum1, load(points.columns[Ds] + i + L) - q[Ds]),
+                        0)... };
+                store(out + i, Squared ? sum0 : square_root(sum0));
+                store(out + i + L, Squared ? sum1 : square_root(sum1));
+            }
+            for (; i < last; ++i) {
+                T sum = 0;
+                (void)std::initializer_list<int>{ (sum = add_square(sum, points.columns[Ds][i] - query[Ds]), 0)... };
+                out[i] = Squared ? sum : std::sqrt(sum);
+            }
+        }
+
+        template <bool Squared, typename T, size_t D>
+        void distances(T const (&query)[D], point_columns<T, D> const& points, T* out) {
+            if (points.size < PARALLEL_DISTANCE_THRESHOLD) {
+                distance_kernel<Squared>(query, points, 0, points.size, out, std::make_index_sequence<D>{});
+                return;
+            }
+
+            auto& pool = parallel::thread_pool::shared();
+            size_t chunks = std::min<size_t>(pool.size() + 1, points.size / (PARALLEL_DISTANCE_THRESHOLD / 4));
+            // Whole blocks per chunk, so that only the last one has a scalar tail
+            size_t block = 2 * simd<T>::LANES;
+            size_t chunk_size = (points.size / chunks + block - 1) / block * block;
+            pool.parallel_for(chunks, [&](size_t c) {
+                size_t first = std::min(c * chunk_size, points.size);
+                size_t last = c + 1 == chunks ? points.size : std::min(first + chunk_size, points.size);
+                distance_kernel<Squared>(query, points, first, last, out, std::make_index_sequence<D>{});
+            });
+        }
+
+        template <typename T, typename Point, size_t... Ds>
+        void to_array(Point const& point, T (&out)[sizeof...(Ds)], std::index_sequence<Ds...>) {
+            (void)std::initializer_list<int>{ (out[Ds] = static_cast<T>(std::get<Ds>(point)), 0)... };
+        }
+
+    }
+
+    // out[i] is the distance from the query to the i-th point; it must have room for points.size values
+    template <typename Point, typename T, size_t D>
+    void distances(Point const& query, point_columns<T, D> const& points, T* out,
+                   distance_kind kind = distance_kind::euclidean) {
+        static_assert(dimension<Point>::value == D, "the query and the points must have the same dimension");
+        T q[D];
+        detail::to_array(query, q, std::make_index_sequence<D>{});
+        if (kind == distance_kind::squared) {
+            detail::distances<true>(q, points, out);
+        } else {
+            detail::distances<false>(q, points, out);
+        }
+    }
+
+    template <typename Point>
+    std::vector<coordinate_t<Point>> distances(Point const& query, soa::soa_vector<Point> const& points,
+                                               distance_kind kind = distance_kind::euclidean) {
+        std::vector<coordinate_t<Point>> result(points.size());
+        distances(query, columns_of(points), result.data(), kind);
+        return result;
+    }
+
+    namespace tests {
+
+        template <typename Point, typename Generator, size_t... Ds>
+        Point random_point(Generator& gen, std::index_sequence<Ds...>) {
+            std::uniform_real_distribution<coordinate_t<Point>> coordinate{ -1000, 1000 };
+            // Braced initializers are evaluated in order, so the points don't depend on the compiler
+            return Point{ (static_cast<void>(Ds), coordinate(gen))... };
+        }
+
+        template <typename Point>
+        soa::soa_vector<Point> random_points(size_t count, unsigned seed) {
+            std::mt19937 gen{ seed };
+            soa::soa_vector<Point> points;
+            points.reserve(count);
+            for (size_t i = 0; i < count; ++i) {
+                points.push_back(random_point<Point>(gen, std::make_index_sequence<dimension<Point>::value>{}));
+            }
+            return points;
+        }
+
+        // One pair at a time, the way the lab1 solution is used today
+        template <typename Point>
+        std::vector<double> scalar_distances(Point const& query, soa::soa_vector<Point> const& points) {
+            std::vector<double> result(points.size());
+            for (size_t i = 0; i < points.size(); ++i) {
+                result[i] = solutions::lab1_sequences::euclidean_distance(query, static_cast<Point>(points[i]));
+            }
+            return result;
+        }
+
+        template <typename T>
+        double max_relative_error(std::vector<double> const& expected, std::vector<T> const& actual) {
+            double error = 0;
+            for (size_t i = 0; i < expected.size(); ++i) {
+                error = std::max(error, std::abs(actual[i] - expected[i]) / std::max(expected[i], 1e-30));
+            }
+            return error;
+        }
+
+    }
+
+}
+
+#endif //TMP_DISTANCE_H
@@ -0,0 +1,421 @@
+#ifndef TMP_FILE_SEARCH_H
+#define TMP_FILE_SEARCH_H
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "compile_time_computation.h"
+#include "thread_pool.h"
+
+namespace compiletime {
+
+    namespace detail {
+
+        bool is_valid_pattern_char(char c) {
+            return isalnum(static_cast<unsigned char>(c)) || c == '*' || c == '?' || c == '.' || c == '_' || c == '-';
+        }
+
+        // A glob is split at its '*'s into pieces that have to appear in order: the first at the start of the
+        // name, the last at the end, and the ones in between anywhere, as early as possible. '?' matches any
+        // single character inside a piece. Pieces is either a static_glob or a runtime_glob.
+        template <typename Pieces>
+        bool match_middle_pieces(Pieces const& pieces, char const* name, size_t n) {
+            size_t const last = pieces.count() - 1;
+            size_t const first_length = pieces.length(0), last_length = pieces.length(last);
+            if (n < first_length + last_length)
+                return false;
+            if (!pieces.piece_matches(0, name) || !pieces.piece_matches(last, name + n - last_length))
+                return false;
+
+            char const* current = name + first_length;
+            char const* end = name + n - last_length;
+            for (size_t piece = 1; piece < last; ++piece) {
+                size_t length = pieces.length(piece);
+                for (;;) {
+                    if (static_cast<size_t>(end - current) < length)
+                        return false;
+                    if (pieces.piece_matches(piece, current))
+                        break;
+                    ++current;
+                }
+                current += length;
+            }
+            return true;
+        }
+
+        template <typename Pieces>
+        bool match_pieces(Pieces const& pieces, char const* name, size_t n, true_t /* no '*' */) {
+            return n == pieces.length(0) && pieces.piece_matches(0, name);
+        }
+
+        template <typename Pieces>
+        bool match_pieces(Pieces const& pieces, char const* name, size_t n, false_t) {
+            return match_middle_pieces(pieces, name, n);
+        }
+
+        template <typename Pieces>
+        bool match_pieces(Pieces const& pieces, char const* name, size_t n) {
+            if (pieces.count() == 1)
+                return match_pieces(pieces, name, n, true_t{});
+            return match_middle_pieces(pieces, name, n);
+        }
+
+        bool piece_matches(char const* piece, size_t length, char const* name, true_t /* has '?' */) {
+            for (size_t i = 0; i < length; ++i) {
+                if (piece[i] != '?' && piece[i] != name[i])
+                    return false;
+            }
+            return true;
+        }
+
+        bool piece_matches(char const* piece, size_t length, char const* name, false_t) {
+            return std::memcmp(piece, name, length) == 0;
+        }
+
+    }
+
+    // Matcher for a glob known at compile time (see FIND_FILES). The split into pieces happens at compile time,
+    // pieces without '?' are compared with memcmp, and globs without '*' are a single length check and compare.
+    template <typename Pattern>
+    class static_glob {
+        constexpr static size_t PIECES = detail::cstr{ Pattern::str() }.count_of('*') + 1;
+        constexpr static bool HAS_QUESTION_MARK = detail::cstr{ Pattern::str() }.count_of('?') != 0;
+        constexpr static detail::cstr_segments<PIECES> segments = detail::split<PIECES>(Pattern::str(), '*');
+
+        static_assert(detail::cstr{ Pattern::str() }.is_valid_pattern(), "pattern contains invalid characters");
+
+    public:
+        constexpr size_t count() const { return PIECES; }
+        constexpr size_t length(size_t piece) const { return segments.length[piece]; }
+
+        bool piece_matches(size_t piece, char const* name) const {
+            return detail::piece_matches(Pattern::str() + segments.offset[piece], segments.length[piece], name,
+                                         bool_t<HAS_QUESTION_MARK>{});
+        }
+
+        bool operator()(char const* name, size_t n) const {
+            return detail::match_pieces(*this, name, n, bool_t<PIECES == 1>{});
+        }
+    };
+
+    template <typename Pattern>
+    constexpr detail::cstr_segments<static_glob<Pattern>::PIECES> static_glob<Pattern>::segments;
+
+    template <typename Pattern>
+    static_glob<Pattern> make_static_glob(Pattern) {
+        return {};
+    }
+
+    // Matcher for a glob that is only known at runtime
+    class runtime_glob {
+        std::string pattern_;
+        std::vector<size_t> offsets_, lengths_;
+        bool has_question_mark_;
+    public:
+        explicit runtime_glob(std::string pattern) : pattern_(std::move(pattern)) {
+            if (!std::all_of(pattern_.begin(), pattern_.end(), detail::is_valid_pattern_char)) {
+                throw std::invalid_argument("pattern contains invalid characters");
+            }
+            size_t start = 0;
+            for (size_t i = 0; i <= pattern_.size(); ++i) {
+                if (i == pattern_.size() || pattern_[i] == '*') {
+                    offsets_.push_back(start);
+                    lengths_.push_back(i - start);
+                    start = i + 1;
+                }
+            }
+            has_question_mark_ = pattern_.find('?') != std::string::npos;
+        }
+
+        size_t count() const { return offsets_.size(); }
+        size_t length(size_t piece) const { return lengths_[piece]; }
+
+        bool piece_matches(size_t piece, char const* name) const {
+            char const* str = pattern_.data() + offsets_[piece];
+            return has_question_mark_ ? detail::piece_matches(str, lengths_[piece], name, true_t{})
+                                      : detail::piece_matches(str, lengths_[piece], name, false_t{});
+        }
+
+        bool operator()(char const* name, size_t n) const {
+            return detail::match_pieces(*this, name, n);
+        }
+    };
+
+    namespace detail {
+
+        // Layout of the records getdents64 fills the buffer with
+        struct linux_dirent64 {
+            unsigned long long d_ino;
+            long long d_off;
+            unsigned short d_reclen;
+            unsigned char d_type;
+            char d_name[1];
+        };
+
+        constexpr size_t GETDENTS_BUFFER_SIZE = 256 * 1024;
+
+        // Directories waiting to be read, shared by all the threads of one walk
+        struct walk_queue {
+            std::mutex lock;
+            std::condition_variable wakeup;
+            std::deque<std::string> directories;
+            size_t busy = 0;
+        };
+
+        bool is_dot_or_dot_dot(char const* name) {
+            return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+        }
+
+        struct file_descriptor {
+            int fd;
+            explicit file_descriptor(int fd) : fd{ fd } {
+            }
+            file_descriptor(file_descriptor const&) = delete;
+            file_descriptor& operator=(file_descriptor const&) = delete;
+            ~file_descriptor() {
+                if (fd != -1) {
+                    ::close(fd);
+                }
+            }
+        };
+
+        int open_directory(std::string const& path) {
+            return ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        }
+
+        // Calls on_entry(name, length, is_directory) for every entry of the open directory except . and ..,
+        // reading as many entries per getdents64 call as fit in the buffer
+        template <typename OnEntry>
+        void list_directory(int fd, std::vector<char>& buffer, OnEntry&& on_entry) {
+            for (;;) {
+                long bytes = ::syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+                if (bytes <= 0)
+                    break;
+
+                for (long offset = 0; offset < bytes;) {
+                    auto entry = reinterpret_cast<linux_dirent64 const*>(buffer.data() + offset);
+                    offset += entry->d_reclen;
+
+                    char const* name = entry->d_name;
+                    if (is_dot_or_dot_dot(name))
+                        continue;
+
+                    bool is_directory = entry->d_type == DT_DIR;
+                    if (entry->d_type == DT_UNKNOWN) {
+                        // Some file systems don't fill in d_type
+                        struct stat st;
+                        is_directory = ::fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+                    }
+                    on_entry(name, std::strlen(name), is_directory);
+                }
+            }
+        }
+
+        // Lists directories straight from the file system
+        struct getdents_lister {
+            template <typename OnEntry>
+            void operator()(std::string const& path, std::vector<char>& buffer, OnEntry&& on_entry) const {
+                file_descriptor dir{ open_directory(path) };
+                if (dir.fd == -1)
+                    return; // Unreadable or vanished since it was listed; skip it like find does
+                list_directory(dir.fd, buffer, on_entry);
+            }
+        };
+
+        template <typename Lister, typename Matcher, typename Callback>
+        void read_directory(std::string const& path, Lister& lister, Matcher const& matcher, Callback& callback,
+                            walk_queue& queue, std::vector<char>& buffer) {
+            std::vector<std::string> subdirectories;
+            std::string child;
+            lister(path, buffer, [&](char const* name, size_t length, bool is_directory) {
+                if (is_directory) {
+                    subdirectories.emplace_back(path);
+                    subdirectories.back().append(1, '/').append(name, length);
+                } else if (matcher(name, length)) {
+                    child.assign(path).append(1, '/').append(name, length);
+                    callback(child);
+                }
+            });
+
+            if (!subdirectories.empty()) {
+                {
+                    std::lock_guard<std::mutex> guard{ queue.lock };
+                    for (auto& dir : subdirectories) {
+                        queue.directories.push_back(std::move(dir));
+                    }
+                }
+                queue.wakeup.notify_all();
+            }
+        }
+
+        template <typename Lister, typename Matcher, typename Callback>
+        void walk_worker(Lister& lister, Matcher const& matcher, Callback& callback, walk_queue& queue) {
+            std::vector<char> buffer(GETDENTS_BUFFER_SIZE);
+            std::unique_lock<std::mutex> guard{ queue.lock };
+            for (;;) {
+                queue.wakeup.wait(guard, [&] { return !queue.directories.empty() || queue.busy == 0; });
+                if (queue.directories.empty())
+                    return; // Nothing queued and nobody left who could queue more
+
+                std::string path = std::move(queue.directories.front());
+                queue.directories.pop_front();
+                ++queue.busy;
+                guard.unlock();
+
+                try {
+                    read_directory(path, lister, matcher, callback, queue, buffer);
+                } catch (...) {
+                    guard.lock();
+                    --queue.busy;
+                    queue.directories.clear();
+                    queue.wakeup.notify_all();
+                    throw;
+                }
+
+                guard.lock();
+                if (--queue.busy == 0 && queue.directories.empty()) {
+                    queue.wakeup.notify_all();
+                }
+            }
+        }
+
+        template <typename Lister, typename Matcher, typename Callback>
+        void walk(std::string const& root, Lister& lister, Matcher const& matcher, Callback& callback,
+                  parallel::thread_pool& pool) {
+            struct stat st;
+            if (::stat(root.c_str(), &st) != 0) {
+                throw std::system_error(errno, std::system_category(), root);
+            }
+            if (!S_ISDIR(st.st_mode)) {
+                throw std::system_error(ENOTDIR, std::system_category(), root);
+            }
+
+            walk_queue queue;
+            queue.directories.push_back(root);
+            pool.parallel_for(pool.size() + 1, [&](size_t) {
+                walk_worker(lister, matcher, callback, queue);
+            });
+        }
+
+    }
+
+    // Walks the tree under 'root' on the thread pool and calls callback(path) for every non-directory entry
+    // whose name matches 'pattern'. The callback is called concurrently from several threads, as matches are
+    // found. Symbolic links are reported like files, and not followed.
+    template <typename Callback>
+    void find_files(std::string const& pattern, std::string const& root, Callback callback,
+                    parallel::thread_pool& pool = parallel::thread_pool::shared()) {
+        detail::getdents_lister lister;
+        detail::walk(root, lister, runtime_glob{ pattern }, callback, pool);
+    }
+
+    template <typename Pattern, typename Callback>
+    void find_files(static_glob<Pattern> const& glob, std::string const& root, Callback callback,
+                    parallel::thread_pool& pool = parallel::thread_pool::shared()) {
+        detail::getdents_lister lister;
+        detail::walk(root, lister, glob, callback, pool);
+    }
+
+    namespace detail {
+
+        template <typename Matcher>
+        std::vector<std::string> collect_files(Matcher const& matcher, std::string const& root) {
+            std::vector<std::string> result;
+            std::mutex lock;
+            auto callback = [&](std::string const& path) {
+                std::lock_guard<std::mutex> guard{ lock };
+                result.push_back(path);
+            };
+            getdents_lister lister;
+            walk(root, lister, matcher, callback, parallel::thread_pool::shared());
+            return result;
+        }
+
+    }
+
+    // Returns the paths of all the matches, in no particular order
+    std::vector<std::string> find_files(std::string const& pattern, std::string const& root = ".") {
+        return detail::collect_files(runtime_glob{ pattern }, root);
+    }
+
+    template <typename Pattern>
+    std::vector<std::string> find_files(static_glob<Pattern> const& glob, std::string const& root = ".") {
+        return detail::collect_files(glob, root);
+    }
+
+    namespace tests {
+
+        // A throwaway directory under /tmp holding empty files at the given relative paths (with '/' making
+        // subdirectories), so that searches don't depend on the machine they run on. Removed on destruction.
+        class file_tree {
+            std::string root_;
+            std::vector<std::string> files_;
+            std::vector<std::string> directories_;
+
+        public:
+            explicit file_tree(std::vector<std::string> files) : files_(std::move(files)) {
+                char root[] = "/tmp/tmp_file_tree_XXXXXX";
+                if (::mkdtemp(root) == nullptr)
+                    throw std::system_error(errno, std::system_category(), root);
+                root_ = root;
+                for (auto const& file : files_) {
+                    for (size_t slash = file.find('/'); slash != std::string::npos; slash = file.find('/', slash + 1)) {
+                        std::string directory = root_ + "/" + file.substr(0, slash);
+                        if (::mkdir(directory.c_str(), 0700) == 0) {
+                            directories_.push_back(directory);
+                        }
+                    }
+                    int fd = ::open((root_ + "/" + file).c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0600);
+                    if (fd >= 0) {
+                        ::close(fd);
+                    }
+                }
+            }
+
+            file_tree(file_tree const&) = delete;
+            file_tree& operator=(file_tree const&) = delete;
+
+            ~file_tree() {
+                for (auto const& file : files_) {
+                    ::unlink((root_ + "/" + file).c_str());
+                }
+                // Created parents first, so removed children first
+                for (auto it = directories_.rbegin(); it != directories_.rend(); ++it) {
+                    ::rmdir(it->c_str());
+                }
+                ::rmdir(root_.c_str());
+            }
+
+            std::string const& root() const {
+                return root_;
+            }
+        };
+
+    }
+
+    // Like find_files, but the pattern must be a string literal: it is validated and split into pieces at compile time
+#define FIND_FILES(pattern, ...) \
+    static_assert(compiletime::detail::cstr{ pattern }.is_valid_pattern(), "pattern contains invalid characters"); \
+    compiletime::find_files(compiletime::make_static_glob(COMPILE_TIME_STRING(pattern)), ##__VA_ARGS__);
+
+}
+
+#endif //TMP_FILE_SEARCH_H
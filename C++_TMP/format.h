@@ -0,0 +1,230 @@
+#ifndef TMP_FORMAT_H
+#define TMP_FORMAT_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "common.h"
+#include "compile_time_computation.h"
+
+namespace variadics {
+
+    // A caller-supplied, fixed-size output buffer. Like snprintf, output that doesn't fit is dropped
+    // but still counted, so size() is the length the full output would have needed.
+    class format_buffer {
+        char* first_;
+        size_t capacity_;
+        size_t size_ = 0;
+    public:
+        format_buffer(char* first, size_t capacity) : first_{ first }, capacity_{ capacity } {
+        }
+
+        template <size_t N>
+        format_buffer(char (&buf)[N]) : format_buffer(buf, N) {
+        }
+
+        void append(char const* s, size_t n) {
+            if (size_ < capacity_) {
+                std::memcpy(first_ + size_, s, std::min(n, capacity_ - size_));
+            }
+            size_ += n;
+        }
+
+        void push_back(char c) {
+            if (size_ < capacity_) {
+                first_[size_] = c;
+            }
+            ++size_;
+        }
+
+        char const* data() const { return first_; }
+        size_t size() const { return size_; }
+        size_t capacity() const { return capacity_; }
+        bool truncated() const { return size_ > capacity_; }
+    };
+
+    namespace detail {
+
+        // Lets operator<< write straight into a format_buffer, for types that don't have a fast path below
+        class format_streambuf : public std::streambuf {
+            format_buffer& out_;
+        public:
+            format_streambuf(format_buffer& out) : out_(out) {
+            }
+        protected:
+            int_type overflow(int_type c) override {
+                if (!traits_type::eq_int_type(c, traits_type::eof())) {
+                    out_.push_back(traits_type::to_char_type(c));
+                }
+                return traits_type::not_eof(c);
+            }
+            std::streamsize xsputn(char const* s, std::streamsize n) override {
+                out_.append(s, static_cast<size_t>(n));
+                return n;
+            }
+        };
+
+        template <typename T>
+        void format_value(format_buffer& out, T const& val, true_t /* integral */, false_t) {
+            using unsigned_t = std::make_unsigned_t<T>;
+            char digits[3 * sizeof(T) + 1];
+            char* first = std::end(digits);
+            unsigned_t u = static_cast<unsigned_t>(val);
+            bool negative = val < T{};
+            if (negative) {
+                u = unsigned_t{} - u;
+            }
+            do {
+                *--first = static_cast<char>('0' + u % 10);
+                u /= 10;
+            } while (u != 0);
+            if (negative) {
+                *--first = '-';
+            }
+            out.append(first, static_cast<size_t>(std::end(digits) - first));
+        }
+
+        template <typename T>
+        void format_value(format_buffer& out, T const& val, false_t, true_t /* floating point */) {
+            // Same as the default std::ostream formatting (%g with precision 6)
+            char digits[32];
+            int n = std::snprintf(digits, sizeof(digits), "%g", static_cast<double>(val));
+            out.append(digits, static_cast<size_t>(n));
+        }
+
+        template <typename T>
+        void format_value(format_buffer& out, T const& val, false_t, false_t) {
+            format_streambuf buf{ out };
+            std::ostream os{ &buf };
+            os << val;
+        }
+
+        template <typename T>
+        void format_value(format_buffer& out, T const& val) {
+            format_value(out, val, bool_t<integral_t<T>::value>{}, bool_t<std::is_floating_point<T>::value>{});
+        }
+
+        // Character types are streamed as characters, not numbers
+        void format_value(format_buffer& out, char c) { out.push_back(c); }
+        void format_value(format_buffer& out, signed char c) { out.push_back(static_cast<char>(c)); }
+        void format_value(format_buffer& out, unsigned char c) { out.push_back(static_cast<char>(c)); }
+
+        void format_value(format_buffer& out, char const* s) {
+            out.append(s, std::strlen(s));
+        }
+
+        void format_value(format_buffer& out, std::string const& s) {
+            out.append(s.data(), s.size());
+        }
+
+    }
+
+    // Format is a type whose static str() returns the literal format, as produced by FORMAT_STRING.
+    // The format is split into literal pieces once, at compile time.
+    template <typename Format>
+    struct parsed_format {
+        constexpr static size_t arg_count = compiletime::detail::cstr(Format::str()).count_of('%');
+        // The literal pieces between the % specifiers
+        constexpr static compiletime::detail::cstr_segments<arg_count + 1> segments =
+                compiletime::detail::split<arg_count + 1>(Format::str(), '%');
+    };
+
+    template <typename Format>
+    constexpr size_t parsed_format<Format>::arg_count;
+
+    template <typename Format>
+    constexpr compiletime::detail::cstr_segments<parsed_format<Format>::arg_count + 1> parsed_format<Format>::segments;
+
+#define FORMAT_STRING(format) COMPILE_TIME_STRING(format)
+
+    namespace detail {
+
+        template <typename Format, typename... Ts, size_t... Ix>
+        void format_to(format_buffer& out, std::index_sequence<Ix...>, Ts const&... args) {
+            using parsed = parsed_format<Format>;
+            char const* format = Format::str();
+            int expand[] = { 0, (
+                    out.append(format + parsed::segments.offset[Ix], parsed::segments.length[Ix]),
+                    format_value(out, args),
+                    0)... };
+            (void)expand;
+            out.append(format + parsed::segments.offset[sizeof...(Ts)], parsed::segments.length[sizeof...(Ts)]);
+        }
+
+    }
+
+    // Writes the formatted output into 'out' in a single pass, without allocating.
+    // Returns the length of the full output, which is larger than the capacity if it was truncated.
+    template <typename Format, typename... Ts>
+    size_t format_to(format_buffer& out, Format, Ts const&... args) {
+        static_assert(parsed_format<Format>::arg_count == sizeof...(Ts),
+                      "number of arguments doesn't match the format string");
+        detail::format_to<Format>(out, std::index_sequence_for<Ts...>{}, args...);
+        return out.size();
+    }
+
+    template <typename Format, typename... Ts>
+    size_t format_to(char* buf, size_t capacity, Format format, Ts const&... args) {
+        format_buffer out{ buf, capacity };
+        return format_to(out, format, args...);
+    }
+
+#define FORMAT_TO(buf, capacity, format, ...) \
+    variadics::format_to(buf, capacity, FORMAT_STRING(format), ##__VA_ARGS__)
+
+    namespace tests {
+
+        struct null_streambuf : std::streambuf {
+        protected:
+            int_type overflow(int_type c) override { return traits_type::not_eof(c); }
+            std::streamsize xsputn(char const*, std::streamsize n) override { return n; }
+        };
+
+#ifdef _DEBUG
+        constexpr int FORMAT_ITERATIONS = 10000;
+#else
+        constexpr int FORMAT_ITERATIONS = 1000000;
+#endif
+
+        template <typename Fn>
+        long long measure_format(Fn fn) {
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < FORMAT_ITERATIONS; ++i) {
+                fn(i);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            return std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+        }
+
+    }
+
+    void format_perf() {
+        tests::null_streambuf null_buf;
+        char buf[256];
+        volatile size_t size = 0;
+
+        // The existing printf always writes to std::cout, so discard its output for the duration
+        auto old_buf = std::cout.rdbuf(&null_buf);
+        auto printf_us = tests::measure_format([](int i) {
+            variadics::printf("id=% name=% value=% ok=%\n", i, "widget", 3.14, 'y');
+        });
+        std::cout.rdbuf(old_buf);
+
+        auto format_to_us = tests::measure_format([&](int i) {
+            size = FORMAT_TO(buf, sizeof(buf), "id=% name=% value=% ok=%\n", i, "widget", 3.14, 'y');
+        });
+
+        std::cout << "[printf   ] elapsed " << printf_us << " us\n";
+        std::cout << "[format_to] elapsed " << format_to_us << " us\n";
+    }
+
+}
+
+#endif //TMP_FORMAT_H
@@ -0,0 +1,70 @@
+#ifndef TMP_ITERATORS_H
+#define TMP_ITERATORS_H
+
+#include <iterator>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "common.h"
+
+namespace traits {
+
+    namespace detail {
+
+        template <typename It, typename V>
+        struct is_library_contiguous_iterator : bool_t<
+                same_v<It, typename std::vector<V>::iterator> ||
+                same_v<It, typename std::vector<V>::const_iterator>
+        > {
+        };
+
+        template <typename It>
+        struct is_library_contiguous_iterator<It, void> : false_t {
+        };
+
+        // vector<bool> packs its elements into bits
+        template <typename It>
+        struct is_library_contiguous_iterator<It, bool> : false_t {
+        };
+
+        template <typename It>
+        struct is_library_contiguous_iterator<It, char> : bool_t<
+                same_v<It, std::vector<char>::iterator> || same_v<It, std::vector<char>::const_iterator> ||
+                same_v<It, std::string::iterator> || same_v<It, std::string::const_iterator>
+        > {
+        };
+
+        template <typename It>
+        struct is_library_contiguous_iterator<It, wchar_t> : bool_t<
+                same_v<It, std::vector<wchar_t>::iterator> || same_v<It, std::vector<wchar_t>::const_iterator> ||
+                same_v<It, std::wstring::iterator> || same_v<It, std::wstring::const_iterator>
+        > {
+        };
+
+        template <typename T>
+        T* to_address(T* ptr) {
+            return ptr;
+        }
+
+        template <typename It>
+        auto to_address(It it) {
+            return std::addressof(*it);
+        }
+
+    }
+
+    // Iterators whose elements are laid out contiguously in memory: raw pointers, and the iterators of vector
+    // and string (array iterators are raw pointers). Specialize this for other contiguous iterators, as traits.h
+    // does for ci_string's.
+    template <typename It>
+    struct is_contiguous_iterator : bool_t<
+            std::is_pointer<It>::value ||
+            detail::is_library_contiguous_iterator<It, std::remove_cv_t<typename std::iterator_traits<It>::value_type>>::value
+    > {
+    };
+
+}
+
+#endif //TMP_ITERATORS_H
@@ -0,0 +1,261 @@
+#ifndef TMP_KD_TREE_H
+#define TMP_KD_TREE_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "distance.h"
+#include "soa.h"
+#include "thread_pool.h"
+
+namespace geometry {
+
+    // A point found by a query: its position in the range the tree was built from, and its distance
+    template <typename T>
+    struct neighbor {
+        size_t index;
+        T distance;
+    };
+
+    // Ranges of at least this many points are built on the shared thread pool
+    constexpr size_t PARALLEL_BUILD_THRESHOLD = 64 * 1024;
+
+    // A k-d tree over tuple points. The tree is implicit: the points are reordered so that every subtree is a
+    // contiguous run with its splitting point in the middle, and only the splitting dimension is stored per
+    // node. Queries compare squared distances and take the square root of the results only.
+    template <typename Point>
+    class kd_tree {
+        using T = coordinate_t<Point>;
+        constexpr static size_t D = dimension<Point>::value;
+        // Runs this short are scanned rather than split
+        constexpr static size_t LEAF_SIZE = 8;
+
+        struct entry {
+            T coordinates[D];
+            size_t index;
+        };
+
+        std::vector<entry> entries_;
+        // The splitting dimension of the node whose splitting point is entries_[i]
+        std::vector<unsigned char> split_;
+
+        template <size_t... Ds>
+        static T squared_distance(T const (&query)[D], T const (&p)[D], std::index_sequence<Ds...>) {
+            T sum = 0;
+            (void)std::initializer_list<int>{ (sum += (p[Ds] - query[Ds]) * (p[Ds] - query[Ds]), 0)... };
+            return sum;
+        }
+
+        static T squared_distance(T const (&query)[D], T const (&p)[D]) {
+            return squared_distance(query, p, std::make_index_sequence<D>{});
+        }
+
+        // Splits [first, last) at its median along the dimension in which it is widest
+        size_t split(size_t first, size_t last) {
+            T low[D], high[D];
+            std::copy(std::begin(entries_[first].coordinates), std::end(entries_[first].coordinates), low);
+            std::copy(std::begin(entries_[first].coordinates), std::end(entries_[first].coordinates), high);
+            for (size_t i = first + 1; i < last; ++i) {
+                for (size_t d = 0; d < D; ++d) {
+                    low[d] = std::min(low[d], entries_[i].coordinates[d]);
+                    high[d] = std::max(high[d], entries_[i].coordinates[d]);
+                }
+            }
+            size_t widest = 0;
+            for (size_t d = 1; d < D; ++d) {
+                if (high[d] - low[d] > high[widest] - low[widest]) {
+                    widest = d;
+                }
+            }
+
+            size_t mid = first + (last - first) / 2;
+            std::nth_element(entries_.begin() + first, entries_.begin() + mid, entries_.begin() + last,
+                             [widest](entry const& a, entry const& b) { return a.coordinates[widest] < b.coordinates[widest]; });
+            split_[mid] = static_cast<unsigned char>(widest);
+            return mid;
+        }
+
+        void build(size_t first, size_t last) {
+            if (last - first <= LEAF_SIZE)
+                return;
+            size_t mid = split(first, last);
+            build(first, mid);
+            build(mid + 1, last);
+        }
+
+        // Splits down to subtrees of at most max_size points, which are independent of each other
+        void split_top(size_t first, size_t last, size_t max_size, std::vector<std::pair<size_t, size_t>>& subtrees) {
+            if (last - first <= max_size) {
+                subtrees.emplace_back(first, last);
+                return;
+            }
+            size_t mid = split(first, last);
+            split_top(first, mid, max_size, subtrees);
+            split_top(mid + 1, last, max_size, subtrees);
+        }
+
+        void build_parallel() {
+            auto& pool = parallel::thread_pool::shared();
+            std::vector<std::pair<size_t, size_t>> subtrees;
+            split_top(0, entries_.size(), std::max(PARALLEL_BUILD_THRESHOLD / 4, entries_.size() / (4 * (pool.size() + 1))), subtrees);
+            pool.parallel_for(subtrees.size(), [&](size_t i) {
+                build(subtrees[i].first, subtrees[i].second);
+            });
+        }
+
+        // Visitor::visit(i, squared distance) sees every point that could be closer than Visitor::bound()
+        template <typename Visitor>
+        void search(T const (&query)[D], size_t first, size_t last, Visitor& visitor) const {
+            if (last - first <= LEAF_SIZE) {
+                for (size_t i = first; i < last; ++i) {
+                    visitor.visit(i, squared_distance(query, entries_[i].coordinates));
+                }
+                return;
+            }
+            size_t mid = first + (last - first) / 2;
+            T delta = query[split_[mid]] - entries_[mid].coordinates[split_[mid]];
+            bool left_first = delta < 0;
+            if (left_first) {
+                search(query, first, mid, visitor);
+            } else {
+                search(query, mid + 1, last, visitor);
+            }
+            visitor.visit(mid, squared_distance(query, entries_[mid].coordinates));
+            if (delta * delta <= visitor.bound()) {
+                if (left_first) {
+                    search(query, mid + 1, last, visitor);
+                } else {
+                    search(query, first, mid, visitor);
+                }
+            }
+        }
+
+        // The k closest so far, as a max-heap on squared distance
+        struct nearest_visitor {
+            size_t k;
+            std::vector<std::pair<T, size_t>> heap;
+
+            void visit(size_t i, T squared) {
+                if (heap.size() < k) {
+                    heap.emplace_back(squared, i);
+                    std::push_heap(heap.begin(), heap.end());
+                } else if (squared < heap.front().first) {
+                    std::pop_heap(heap.begin(), heap.end());
+                    heap.back() = { squared, i };
+                    std::push_heap(heap.begin(), heap.end());
+                }
+            }
+
+            T bound() const {
+                return heap.size() < k ? std::numeric_limits<T>::infinity() : heap.front().first;
+            }
+        };
+
+        struct radius_visitor {
+            T squared_radius;
+            std::vector<std::pair<T, size_t>> found;
+
+            void visit(size_t i, T squared) {
+                if (squared <= squared_radius) {
+                    found.emplace_back(squared, i);
+                }
+            }
+
+            T bound() const {
+                return squared_radius;
+            }
+        };
+
+        std::vector<neighbor<T>> neighbors(std::vector<std::pair<T, size_t>> const& found) const {
+            std::vector<neighbor<T>> result;
+            result.reserve(found.size());
+            for (auto const& f : found) {
+                result.push_back(neighbor<T>{ entries_[f.second].index, std::sqrt(f.first) });
+            }
+            return result;
+        }
+
+    public:
+        // The points can be a soa::soa_vector<Point>, a std::vector<Point> or any other range of Points;
+        // neighbors are reported by their position in it
+        template <typename Range>
+        explicit kd_tree(Range const& points, bool parallel = true) {
+            size_t index = 0;
+            for (auto const& p : points) {
+                entry e;
+                detail::to_array(static_cast<Point>(p), e.coordinates, std::make_index_sequence<D>{});
+                e.index = index++;
+                entries_.push_back(e);
+            }
+            split_.resize(entries_.size());
+            if (parallel && entries_.size() >= PARALLEL_BUILD_THRESHOLD) {
+                build_parallel();
+            } else {
+                build(0, entries_.size());
+            }
+        }
+
+        size_t size() const {
+            return entries_.size();
+        }
+
+        // The k points closest to the query (fewer if the tree is smaller), closest first
+        std::vector<neighbor<T>> nearest(Point const& query, size_t k) const {
+            T q[D];
+            detail::to_array(query, q, std::make_index_sequence<D>{});
+            nearest_visitor visitor{ k, {} };
+            if (k != 0) {
+                visitor.heap.reserve(k);
+                search(q, 0, entries_.size(), visitor);
+            }
+            std::sort_heap(visitor.heap.begin(), visitor.heap.end());
+            return neighbors(visitor.heap);
+        }
+
+        // Every point at most 'radius' away from the query, in no particular order
+        std::vector<neighbor<T>> within(Point const& query, T radius) const {
+            T q[D];
+            detail::to_array(query, q, std::make_index_sequence<D>{});
+            radius_visitor visitor{ radius * radius, {} };
+            search(q, 0, entries_.size(), visitor);
+            return neighbors(visitor.found);
+        }
+    };
+
+    namespace tests {
+
+        // The k nearest by computing every distance
+        template <typename Point>
+        std::vector<neighbor<coordinate_t<Point>>> brute_force_nearest(Point const& query, soa::soa_vector<Point> const& points,
+                                                                       size_t k, std::vector<coordinate_t<Point>>& scratch) {
+            using T = coordinate_t<Point>;
+            scratch.resize(points.size());
+            distances(query, columns_of(points), scratch.data(), distance_kind::squared);
+            std::vector<std::pair<T, size_t>> closest;
+            for (size_t i = 0; i < points.size(); ++i) {
+                if (closest.size() < k) {
+                    closest.emplace_back(scratch[i], i);
+                    std::push_heap(closest.begin(), closest.end());
+                } else if (k != 0 && scratch[i] < closest.front().first) {
+                    std::pop_heap(closest.begin(), closest.end());
+                    closest.back() = { scratch[i], i };
+                    std::push_heap(closest.begin(), closest.end());
+                }
+            }
+            std::sort_heap(closest.begin(), closest.end());
+            std::vector<neighbor<T>> result;
+            for (auto const& c : closest) {
+                result.push_back(neighbor<T>{ c.second, std::sqrt(c.first) });
+            }
+            return result;
+        }
+
+    }
+
+}
+
+#endif //TMP_KD_TREE_H
@@ -0,0 +1,123 @@
+#ifndef TMP_LINEAR_SEARCH_H
+#define TMP_LINEAR_SEARCH_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) && !defined(__AVX__)
+#include <emmintrin.h>
+#endif
+
+#include "common.h"
+#include "iterators.h"
+#include "simd.h"
+
+// The vectorized kernel behind solutions::lab3::linear_search, which only needs the simd types rather than
+// the range reductions
+namespace solutions {
+
+    namespace lab3 {
+
+        // Searches that can compare the elements a register at a time: the elements are arithmetic and
+        // contiguous, and converting them to the type they are compared in can't make two of them equal
+        template <typename It, typename T, typename E = std::decay_t<decltype(*std::declval<It>())>>
+        using is_vectorizable_search_t = bool_t<
+                traits::is_contiguous_iterator<It>::value &&
+                std::is_arithmetic<E>::value && !std::is_same<E, bool>::value &&
+                std::is_arithmetic<T>::value &&
+                (std::is_integral<std::common_type_t<E, T>>::value ||
+                 std::numeric_limits<std::common_type_t<E, T>>::digits >= std::numeric_limits<E>::digits)
+        >;
+
+        namespace detail {
+
+            using compiletime::detail::simd;
+            using compiletime::detail::load;
+
+            // One bit per byte of the comparison result, set where the lane matched
+            template <typename Mask>
+            uint32_t byte_mask(Mask mask) {
+#if defined(__AVX2__)
+                return static_cast<uint32_t>(_mm256_movemask_epi8((__m256i)mask));
+#elif defined(__SSE2__) && !defined(__AVX__)
+                return static_cast<uint32_t>(_mm_movemask_epi8((__m128i)mask));
+#else
+                constexpr size_t lane_bytes = sizeof(mask[0]);
+                uint32_t bits = 0;
+                for (size_t lane = 0; lane < sizeof(Mask) / lane_bytes; ++lane) {
+                    if (mask[lane]) {
+                        bits |= ((1u << lane_bytes) - 1) << (lane * lane_bytes);
+                    }
+                }
+                return bits;
+#endif
+            }
+
+            // Index of the first element equal to key, or n. Four registers are compared per step and
+            // checked together, so the loop branches once per 4 * LANES elements.
+            template <typename T>
+            size_t find_kernel(T const* p, size_t n, T key) {
+                using vec = typename simd<T>::type;
+                constexpr size_t L = simd<T>::LANES;
+                vec const k = vec{} + key;
+                size_t i = 0;
+                for (; i + 4 * L <= n; i += 4 * L) {
+                    auto m0 = load(p + i) == k, m1 = load(p + i + L) == k;
+                    auto m2 = load(p + i + 2 * L) == k, m3 = load(p + i + 3 * L) == k;
+                    if (byte_mask((m0 | m1) | (m2 | m3)) == 0)
+                        continue;
+                    for (auto m : { m0, m1, m2, m3 }) {
+                        if (uint32_t bits = byte_mask(m))
+                            return i + __builtin_ctz(bits) / sizeof(T);
+                        i += L;
+                    }
+                }
+                for (; i + L <= n; i += L) {
+                    if (uint32_t bits = byte_mask(load(p + i) == k))
+                        return i + __builtin_ctz(bits) / sizeof(T);
+                }
+                for (; i < n; ++i) {
+                    if (p[i] == key)
+                        return i;
+                }
+                return n;
+            }
+
+            // Whether static_cast<E>(val) is defined. Integers convert to any arithmetic type; a floating point
+            // value must be within E's range, and an infinity or a NaN only converts to a floating point E.
+            template <typename E, typename T>
+            bool can_convert(T const&, false_t) {
+                return true;
+            }
+
+            // is_vectorizable_search_t makes sure E's limits are exact in T when E is an integer
+            template <typename E, typename T>
+            bool can_convert(T const& val, true_t) {
+                if (std::isnan(val) || std::isinf(val))
+                    return std::is_floating_point<E>::value;
+                return val >= static_cast<T>(std::numeric_limits<E>::lowest()) &&
+                       val <= static_cast<T>(std::numeric_limits<E>::max());
+            }
+
+            // The element to look for; false if no element can equal val, which isn't converted then
+            template <typename E, typename T>
+            bool search_key(T const& val, E& key) {
+                if (!can_convert<E>(val, bool_t<std::is_floating_point<T>::value>{}))
+                    return false;
+                key = static_cast<E>(val);
+                return key == val;
+            }
+
+        }
+
+    }
+
+}
+
+#endif //TMP_LINEAR_SEARCH_H
@@ -1,17 +1,34 @@
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <map>
 #include <vector>
 #include <list>
+#include <sstream>
 
 #include "variadics.h"
+#include "format.h"
+#include "sinks.h"
 #include "compile_time_computation.h"
+#include "range_reductions.h"
+#include "file_search.h"
+#include "directory_cache.h"
 #include "traits.h"
+#include "symbols.h"
 #include "policies.h"
 #include "member_detection.h"
+#include "serialization.h"
+#include "mapped_file.h"
+#include "soa.h"
+#include "distance.h"
+#include "kd_tree.h"
+#include "type_registry.h"
 #include "sequences.h"
 #include "tuple_cat.h"
+#include "benchmarks.h"
 
 #include "solutions.h"
+#include "parallel_search.h"
 
 using namespace std::string_literals;
 
@@ -29,6 +46,22 @@ void variadics_test() {
     variadics::printf("The value of pi is % and this conference is %\n", 3.14, "SDP");
     try_and_print_exception([] { variadics::printf("Missing parameter %\n"); });
     try_and_print_exception([] { variadics::printf("Too many parameters %\n", 42, 43); });
+
+    char buf[64];
+    auto size = FORMAT_TO(buf, sizeof(buf), "The value of pi is % and this conference is %\n", 3.14, "SDP");
+    // The returned size is the full length, which is more than was written when the output didn't fit
+    std::cout.write(buf, std::min(size, sizeof(buf)));
+    // This doesn't compile:
+    // FORMAT_TO(buf, sizeof(buf), "Missing parameter %\n");
+
+    std::cout.flush();
+    {
+        variadics::buffered_fd_sink out{ STDOUT_FILENO };
+        auto& previous = variadics::set_sink(out);
+        variadics::print("buffered", 42);
+        variadics::printf("% and % reach stdout as a single write\n", "these", "lines");
+        variadics::set_sink(previous);
+    }
 }
 
 void compile_time_test() {
@@ -36,8 +69,47 @@ void compile_time_test() {
     static_assert(same_v<decltype(maxval), unsigned long long>, "");
     std::cout << "maxval = " << maxval << ", type = " << typeid(maxval).name() << '\n';
 
-    compiletime::find_files("what?ver*"s);
-    FIND_FILES("what?ver*");
+    std::vector<short> shorts{ 3, -7, 511 };
+    std::vector<double> doubles{ 0.5, 2.25 };
+    int ints[] = { 1, 2, 3, 4 };
+    auto range_max = compiletime::range_max(shorts, doubles, ints);
+    static_assert(same_v<decltype(range_max), double>, "");
+    auto range_sum = compiletime::range_sum(ints, compiletime::make_span(shorts.data(), 2));
+    auto range_minmax = compiletime::range_minmax(shorts, ints);
+    std::cout << "range_max = " << range_max << ", range_sum = " << range_sum
+              << ", range_minmax = [" << range_minmax.min << ", " << range_minmax.max << "]\n";
+    try_and_print_exception([] { compiletime::range_max(std::vector<int>{}); });
+
+    // Narrow elements are widened before they are added, so these don't wrap around
+    auto short_sum = compiletime::range_sum(std::vector<short>(1000, 1000));
+    static_assert(same_v<decltype(short_sum), int>, "");
+    auto mixed_sum = compiletime::range_sum(std::vector<unsigned char>(1000, 200), std::vector<long long>{ 1 });
+    static_assert(same_v<decltype(mixed_sum), long long>, "");
+    std::cout << "narrow sums = " << short_sum << ", " << mixed_sum << '\n';
+
+    compiletime::tests::file_tree fixture{ { "whatever.h", "notes/whatsoever.txt", "src/main.cpp", "src/util.h",
+                                             "src/detail/impl.cpp", "src/detail/impl.h" } };
+    std::string root = fixture.root();
+    std::cout << "whatever: " << compiletime::find_files("what?ver*"s, root).size() << '\n';
+    FIND_FILES("what?ver*", root);
+    std::cout << "headers: " << compiletime::find_files("*.h"s, root).size() << '\n';
+    std::vector<std::string> sources;
+    std::mutex lock;
+    FIND_FILES("*.cpp", root, [&](std::string const& path) {
+        std::lock_guard<std::mutex> guard{ lock };
+        sources.push_back(path.substr(root.size()));
+    });
+    std::sort(sources.begin(), sources.end());
+    for (auto const& path : sources) {
+        std::cout << "found " << path << '\n';
+    }
+
+    compiletime::directory_cache cache;
+    for (int i = 0; i < 2; ++i) {
+        FIND_FILES("*.h", root, [](std::string const&) {}, cache);
+    }
+    auto stats = cache.stats();
+    std::cout << "directory cache hits = " << stats.hits << ", misses = " << stats.misses << '\n';
     try_and_print_exception([] { compiletime::find_files("invalid$$$"s); });
     // FIND_FILES("invalid$$$");
 
@@ -49,6 +121,10 @@ void traits_test() {
     traits::ci_string a("hello"), b("HellO");
     std::cout << "these strings are equal: " << std::boolalpha << (a == b) << '\n';
 
+    traits::ci_symbol_table symbols;
+    auto sa = symbols.intern(a), sb = symbols.intern(b);
+    std::cout << "these symbols are equal: " << (sa == sb) << ", interned as " << symbols.c_str(sa) << '\n';
+
     struct Integer {
         Integer() {}
         Integer(int) {}
@@ -64,10 +140,42 @@ void traits_test() {
     traits::copy(v1.begin(), v1.end(), v3.begin());
     traits::copy(v1.begin(), v1.end(), v4.begin());
     traits::copy(std::begin(v5), std::end(v5), std::begin(v6));
+
+    static_assert(!traits::detail::is_safe_to_memmove_iter_t<decltype(v1.begin()), decltype(v2.begin())>{}, "");
+    static_assert(traits::detail::is_safe_to_memmove_iter_t<decltype(v1.begin()), decltype(v3.begin())>{}, "");
+    static_assert(!traits::detail::is_safe_to_memmove_iter_t<decltype(v1.begin()), decltype(v4.begin())>{}, "");
+    static_assert(traits::detail::is_safe_to_memmove_iter_t<int*, int*>{}, "");
+
+    std::vector<int> big(4 * 1024 * 1024, 7), big_copy(big.size());
+    traits::bulk_copy(big.begin(), big.end(), big_copy.begin());
+    std::cout << "bulk copied: " << traits::equal(big.begin(), big.end(), big_copy.begin()) << '\n';
+
+    traits::fill(v3.begin(), v3.end(), 0);
+    std::cout << "copied and cleared: " << traits::equal(v1.begin(), v1.end(), std::begin(v6))
+              << ", " << traits::equal(v3.begin(), v3.end(), std::vector<int>(3).begin()) << '\n';
 }
 
 void policies_test() {
     try_and_print_exception([] { policies::non_null_ptr<std::string> ps{ nullptr }; });
+
+    auto pooled = policies::make_smart_ptr<std::string, policies::non_null_policy, policies::pool_policy>("pooled");
+    policies::arena arena;
+    policies::arena_ptr<std::string> in_arena = policies::make_smart_ptr<std::string, policies::unsafe_policy, policies::arena_policy>("in an arena");
+    std::cout << *pooled << ", " << *in_arena << '\n';
+    try_and_print_exception([&] { pooled.reset(nullptr); });
+
+    auto shared = policies::make_counted_ptr<std::string, policies::non_null_policy, policies::biased_policy>("shared");
+    std::thread([copy = shared] { std::cout << *copy << " from another thread\n"; }).join();
+    std::cout << *shared << " use_count = " << shared.use_count() << '\n';
+    try_and_print_exception([] { policies::counted_ptr<int, policies::non_null_policy, policies::single_threaded_policy> p{ nullptr }; });
+
+    policies::atomic_ptr<std::string> config{ new std::string{ "config v1" } };
+    {
+        auto current = config.read();
+        config.emplace("config v2");
+        std::cout << "still reading " << *current << " while " << *config.read() << " is published\n";
+    }
+    policies::epoch_policy::flush();
 }
 
 void member_detection_test() {
@@ -79,6 +187,88 @@ void member_detection_test() {
     member_detection::dump(std::cout, 42);
     member_detection::dump(std::cout, std::vector<int>{ 1,2,3 });
     member_detection::dump(std::cout, std::vector<std::vector<int>> { {1,2}, {3,4} });
+
+    static_assert(!member_detection::is_container<std::string>::value, "");
+    static_assert(member_detection::is_container<int[3]>::value, "");
+    std::stringstream stream;
+    {
+        serialization::buffered_writer out{ stream };
+        serialization::serialize(out, std::make_tuple(std::vector<int>{ 1, 2, 3 }, std::string{ "hello" }, 3.14));
+    }
+    std::tuple<std::vector<int>, std::string, double> loaded;
+    serialization::buffered_reader in{ stream };
+    serialization::deserialize(in, loaded);
+    std::cout << "serialized " << stream.str().size() << " bytes, read back \"" << std::get<1>(loaded) << "\"\n";
+
+    // std::vector<bool> is written as one bool per element, not as the proxies its iterators return
+    using saved = std::tuple<std::vector<int>, std::map<std::string, std::vector<double>>, std::vector<bool>, std::list<std::string>>;
+    std::string file = "/tmp/tmp_member_detection_test.bin";
+    serialization::save(file, saved{ { 1, 2, 3 }, { { "a", { 0.5, 1.5 } }, { "b", {} } }, { true, false, true }, { "x", "yz" } });
+    {
+        serialization::mapped_file<saved> mapped{ file };
+        auto root = mapped.root();
+        std::cout << "mapped " << serialization::layout_description<saved>() << ": sum " << compiletime::range_sum(root.member<0>())
+                  << ", " << root.member<1>()[0].first().get() << " has " << root.member<1>()[0].second().size()
+                  << " samples, " << root.member<2>().size() << " flags, last name " << root.member<3>()[1].get() << "\n";
+    }
+    try {
+        serialization::mapped_file<std::vector<float>> wrong{ file };
+    } catch (std::runtime_error const& e) {
+        std::cout << "caught exception: " << e.what() << "\n";
+    }
+    unlink(file.c_str());
+}
+
+void soa_test() {
+    soa::soa_vector<std::tuple<double, double, int>> points{ std::make_tuple(1.0, 2.0, 7) };
+    points.push_back(std::make_tuple(3.0, 4.0, 8));
+    points.emplace_back(5.0, 6.0, 9);
+    soa::get<int>(points[1]) = 42;
+    std::tuple<double, double, int> last = points.at(2);
+    std::cout << "soa: " << points.size() << " points, x sum " << compiletime::range_sum(points.column<0>())
+              << ", second id " << soa::get<2>(points[1]) << ", last y " << std::get<1>(last) << "\n";
+
+    // Rows assign and swap the elements they refer to, so the iterators work with the standard algorithms
+    points[0] = points[2];
+    std::sort(points.begin(), points.end(), [](std::tuple<double, double, int> const& a, std::tuple<double, double, int> const& b) {
+        return std::get<2>(a) < std::get<2>(b);
+    });
+    std::reverse(points.begin(), points.end());
+    std::cout << "soa ids after copy, sort and reverse: " << soa::get<2>(points[0]) << ", " << soa::get<2>(points[1])
+              << ", " << soa::get<2>(points[2]) << "\n";
+}
+
+void distance_test() {
+    soa::soa_vector<std::tuple<double, double, double>> points;
+    for (int i = 0; i < 20; ++i) {
+        points.emplace_back(i, 2.0 * i, 1.0);
+    }
+    auto query = std::make_tuple(1.0, 0.0, 2.0);
+    auto d = geometry::distances(query, points);
+    std::cout << "distance to point 19: " << d[19] << " (lab1: "
+              << solutions::lab1_sequences::euclidean_distance(query, static_cast<std::tuple<double, double, double>>(points[19]))
+              << "), squared: " << geometry::distances(query, points, geometry::distance_kind::squared)[19] << "\n";
+
+    geometry::kd_tree<std::tuple<double, double, double>> tree{ points };
+    auto nearest = tree.nearest(query, 2);
+    std::cout << "nearest to (1, 0, 2): points " << nearest[0].index << " and " << nearest[1].index
+              << ", " << tree.within(query, 5.0).size() << " within 5\n";
+}
+
+void registry_test() {
+    registry::static_registry<int, std::string> fixed{ 42, "hello" };
+    static_assert(decltype(fixed)::index_of<std::string>::value == 1, "");
+    registry::type_registry dynamic;
+    dynamic.emplace<std::string>("world");
+    ++dynamic.emplace<int>(1);
+    std::cout << "registries: " << fixed.get<int>() << " " << fixed.get<std::string>() << ", "
+              << dynamic.get<int>() << " " << dynamic.get<std::string>() << "\n";
+    dynamic.erase<int>();
+    try {
+        dynamic.get<int>();
+    } catch (std::out_of_range const& e) {
+        std::cout << "caught exception: " << e.what() << "\n";
+    }
 }
 
 void sequences_test() {
@@ -90,6 +280,22 @@ void sequences_test() {
     sequences::print_tuple(tup);
 }
 
+void tuple_cat_test() {
+    auto tup1 = std::make_tuple(1, std::string{ "hello" });
+    auto const tup2 = std::make_tuple('a');
+    std::tuple<> empty;
+    auto view = tupcat::lazy::make_tuple_cat_view(tup1, empty, tup2);
+    static_assert(std::tuple_size<decltype(view)>::value == 3, "");
+    static_assert(same_v<std::tuple_element_t<1, decltype(view)>, std::string>, "");
+    static_assert(same_v<decltype(tupcat::lazy::get<2>(view)), char const&>, "");
+    tupcat::lazy::get<0>(view) = 2;
+
+    auto moved = tupcat::inplace::tuple_cat(std::move(tup1), tup2);
+    static_assert(same_v<decltype(moved), std::tuple<int, std::string, char>>, "");
+    std::cout << std::get<0>(moved) << ' ' << std::get<1>(moved) << ' ' << std::get<2>(moved)
+              << " (moved-from source is now \"" << std::get<1>(tup1) << "\")\n";
+}
+
 void solutions_test() {
 
     std::cout << solutions::lab1_direct::euclidean_distance(
@@ -108,6 +314,19 @@ void solutions_test() {
 
     std::vector<int> v{ -1, 43, 5, 42, 7 };
     std::cout << *solutions::lab3::linear_search(v.begin(), v.end(), 42) << '\n';
+    std::vector<char> text(100000, 'a');
+    text[99999] = 'b';
+    std::cout << solutions::lab3::linear_search(text.begin(), text.end(), 'b') - text.begin() << " "
+              << solutions::lab3::linear_search(text.begin(), text.end(), 'b' + 256) - text.begin() << " "
+              << solutions::lab3::linear_search(text.begin(), text.end(), 'b', solutions::lab3::multithreaded) - text.begin() << '\n';
+    // Large enough to be split across the thread pool; the first match is at the start of a chunk after the first
+    std::vector<int> numbers(3 * solutions::lab3::PARALLEL_SEARCH_THRESHOLD, 0);
+    size_t chunk = solutions::lab3::PARALLEL_SEARCH_THRESHOLD / 4;
+    numbers[5 * chunk] = numbers.back() = 7;
+    std::cout << (solutions::lab3::linear_search(numbers.begin(), numbers.end(), 7, solutions::lab3::multithreaded) - numbers.begin()) / chunk
+              << " chunks in, " << solutions::lab3::linear_search(numbers.begin(), numbers.end(), 7.5, solutions::lab3::multithreaded) - numbers.end()
+              << " " << solutions::lab3::linear_search(numbers.begin(), numbers.end(), 3e9) - numbers.end()
+              << " " << solutions::lab3::linear_search(numbers.begin(), numbers.end(), std::nan("")) - numbers.end() << '\n';
     struct non_equatable {};
     std::vector<non_equatable> u(2);
     // This doesn't compile, which is what we wanted:
@@ -137,8 +356,26 @@ int main() {
     traits_test();
     policies_test();
     member_detection_test();
+    soa_test();
+    distance_test();
+    registry_test();
     sequences_test();
+    tuple_cat_test();
     // tupcat::tuple_cat_perf(); // commented-out because it is a bit slow
+    // variadics::format_perf();
+    // traits::ci_traits_perf();
+    // traits::bulk_copy_perf();
+    // compiletime::range_reductions_perf();
+    // policies::allocation_perf();
+    // policies::sharing_perf();
+    // policies::read_scaling_perf();
+    // serialization::serialization_perf();
+    // serialization::mapped_file_perf();
+    // soa::soa_perf();
+    // geometry::distance_perf();
+    // geometry::kd_tree_perf();
+    // registry::registry_perf();
+    // solutions::linear_search_perf();
 
     solutions_test();
 
@@ -0,0 +1,369 @@
+#ifndef TMP_MAPPED_FILE_H
+#define TMP_MAPPED_FILE_H
+
+#include <cerrno>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "member_detection.h"
+#include "serialization.h"
+
+// Reads a file written by serialization::save in place. The file is mapped rather than read, and what it
+// holds is reached through views: contiguous containers of trivially copyable elements (and strings and
+// built-in arrays of them) are spans pointing into the mapping, and everything else is decoded only when
+// it is asked for. Every view has get(), which builds the value it stands for.
+namespace serialization {
+
+    // Read-only elements inside a mapping; valid as long as the mapped_file is
+    template <typename T>
+    class span {
+        T const* data_ = nullptr;
+        size_t size_ = 0;
+    public:
+        span() = default;
+
+        span(T const* data, size_t size) : data_{ data }, size_{ size } {
+        }
+
+        T const* data() const {
+            return data_;
+        }
+
+        size_t size() const {
+            return size_;
+        }
+
+        bool empty() const {
+            return size_ == 0;
+        }
+
+        T const* begin() const {
+            return data_;
+        }
+
+        T const* end() const {
+            return data_ + size_;
+        }
+
+        T const& operator[](size_t i) const {
+            return data_[i];
+        }
+    };
+
+    namespace detail {
+
+        template <typename T, bool = member_detection::is_container<T>::value>
+        struct view_of;
+
+    }
+
+    // The view of a serialized T
+    template <typename T>
+    using view_t = typename detail::view_of<std::remove_cv_t<std::remove_reference_t<T>>>::type;
+
+    namespace detail {
+
+        // The serialized value starts at 'begin'; 'end' is the end of the mapping, which bounds every read
+        template <typename T>
+        class view_base {
+        protected:
+            char const* begin_;
+            char const* end_;
+
+            memory_reader reader() const {
+                return memory_reader{ begin_, end_ };
+            }
+
+        public:
+            view_base(char const* begin, char const* end) : begin_{ begin }, end_{ end } {
+            }
+
+            T get() const {
+                memory_reader in = reader();
+                T value;
+                read(in, value);
+                return value;
+            }
+        };
+
+        template <typename T>
+        class value_view : public view_base<T> {
+        public:
+            using view_base<T>::view_base;
+        };
+
+        // A size and then that many elements in one aligned block, which is what the span covers
+        template <typename T, typename Element>
+        class block_view : public view_base<T>, public span<Element> {
+            static span<Element> elements(memory_reader in) {
+                size_t size = read_size(in);
+                in.align(alignof(Element));
+                return span<Element>{ in.take_array<Element>(size), size };
+            }
+
+        public:
+            block_view(char const* begin, char const* end)
+                    : view_base<T>{ begin, end }, span<Element>{ elements(memory_reader{ begin, end }) } {
+            }
+        };
+
+        // A built-in array of trivially copyable elements; as arrays can't be returned, it has no get()
+        template <typename T, size_t N>
+        class array_view : public span<T> {
+            static span<T> elements(memory_reader in) {
+                in.align(alignof(T));
+                return span<T>{ in.take_array<T>(N), N };
+            }
+
+        public:
+            array_view(char const* begin, char const* end) : span<T>{ elements(memory_reader{ begin, end }) } {
+            }
+        };
+
+        // Elements that have to be decoded one at a time. Iterating walks them in order; the first use of
+        // operator[] walks all of them once to find where each starts.
+        template <typename Element>
+        class elements_view {
+            memory_reader first_;
+            size_t size_;
+            mutable std::vector<char const*> offsets_;
+
+        public:
+            class iterator {
+                memory_reader next_;
+                size_t index_;
+            public:
+                using iterator_category = std::forward_iterator_tag;
+                using value_type = view_t<Element>;
+                using difference_type = std::ptrdiff_t;
+                using pointer = void;
+                using reference = value_type;
+
+                iterator(memory_reader next, size_t index) : next_{ next }, index_{ index } {
+                }
+
+                value_type operator*() const {
+                    return value_type{ next_.position(), next_.end() };
+                }
+
+                iterator& operator++() {
+                    format<Element>::skip(next_);
+                    ++index_;
+                    return *this;
+                }
+
+                iterator operator++(int) {
+                    iterator previous = *this;
+                    ++*this;
+                    return previous;
+                }
+
+                bool operator==(iterator const& other) const {
+                    return index_ == other.index_;
+                }
+
+                bool operator!=(iterator const& other) const {
+                    return index_ != other.index_;
+                }
+            };
+
+            elements_view(memory_reader first, size_t size) : first_{ first }, size_{ size } {
+            }
+
+            size_t size() const {
+                return size_;
+            }
+
+            bool empty() const {
+                return size_ == 0;
+            }
+
+            iterator begin() const {
+                return iterator{ first_, 0 };
+            }
+
+            iterator end() const {
+                return iterator{ first_, size_ };
+            }
+
+            // Throws std::out_of_range
+            view_t<Element> operator[](size_t i) const {
+                if (i >= size_)
+                    throw std::out_of_range("serialized element index out of range");
+                if (offsets_.empty()) {
+                    memory_reader in = first_;
+                    offsets_.reserve(size_);
+                    for (size_t j = 0; j < size_; ++j) {
+                        offsets_.push_back(in.position());
+                        format<Element>::skip(in);
+                    }
+                }
+                return view_t<Element>{ offsets_[i], first_.end() };
+            }
+        };
+
+        template <typename T>
+        class container_view : public view_base<T>, public elements_view<storage_t<element_t<T>>> {
+            using elements = elements_view<storage_t<element_t<T>>>;
+
+            static elements after_size(memory_reader in) {
+                size_t size = read_size(in);
+                return elements{ in, size };
+            }
+
+        public:
+            container_view(char const* begin, char const* end)
+                    : view_base<T>{ begin, end }, elements{ after_size(memory_reader{ begin, end }) } {
+            }
+        };
+
+        template <typename T, size_t N>
+        class elements_array_view : public elements_view<T> {
+        public:
+            elements_array_view(char const* begin, char const* end) : elements_view<T>{ memory_reader{ begin, end }, N } {
+            }
+        };
+
+        template <typename A, typename B>
+        class pair_view : public view_base<std::pair<A, B>> {
+        public:
+            using view_base<std::pair<A, B>>::view_base;
+
+            view_t<A> first() const {
+                return view_t<A>{ this->begin_, this->end_ };
+            }
+
+            view_t<B> second() const {
+                memory_reader in = this->reader();
+                member_format<A>::skip(in);
+                return view_t<B>{ in.position(), this->end_ };
+            }
+        };
+
+        // member<I>() steps over the members before I each time, which only costs anything when one of them
+        // is a container that isn't stored as one block
+        template <typename... Ts>
+        class tuple_view : public view_base<std::tuple<Ts...>> {
+            template <size_t... Is>
+            static void skip(memory_reader& in, std::index_sequence<Is...>) {
+                (void)std::initializer_list<int>{ (member_format<std::tuple_element_t<Is, std::tuple<Ts...>>>::skip(in), 0)... };
+            }
+
+        public:
+            using view_base<std::tuple<Ts...>>::view_base;
+
+            template <size_t I>
+            view_t<std::tuple_element_t<I, std::tuple<Ts...>>> member() const {
+                memory_reader in = this->reader();
+                skip(in, std::make_index_sequence<I>{});
+                return view_t<std::tuple_element_t<I, std::tuple<Ts...>>>{ in.position(), this->end_ };
+            }
+        };
+
+        template <typename T>
+        struct view_of<T, false> {
+            using type = value_view<T>;
+        };
+
+        template <typename T>
+        struct view_of<T, true> {
+            using type = std::conditional_t<is_bulk_container_t<T>::value, block_view<T, element_t<T>>, container_view<T>>;
+        };
+
+        template <typename CharT, typename Traits, typename Allocator>
+        struct view_of<std::basic_string<CharT, Traits, Allocator>, false> {
+            using type = block_view<std::basic_string<CharT, Traits, Allocator>, CharT>;
+        };
+
+        template <typename T, size_t N>
+        struct view_of<T[N], true> {
+            using type = std::conditional_t<std::is_trivially_copyable<T>::value, array_view<T, N>, elements_array_view<T, N>>;
+        };
+
+        template <typename A, typename B>
+        struct view_of<std::pair<A, B>, false> {
+            using type = pair_view<A, B>;
+        };
+
+        template <typename... Ts>
+        struct view_of<std::tuple<Ts...>, false> {
+            using type = tuple_view<Ts...>;
+        };
+
+    }
+
+    // A file written by save<T>, mapped read-only. Opening checks that the file was saved from a T (or a
+    // type with the same layout_description, which only records the size of a struct or enum); reads past the
+    // end of a damaged file throw rather than run off the mapping.
+    template <typename T>
+    class mapped_file {
+        char const* data_ = nullptr;
+        size_t size_ = 0;
+
+    public:
+        explicit mapped_file(std::string const& file) {
+            int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                throw std::system_error(errno, std::system_category(), file);
+            struct stat st;
+            if (fstat(fd, &st) != 0) {
+                int error = errno;
+                close(fd);
+                throw std::system_error(error, std::system_category(), file);
+            }
+            if (static_cast<size_t>(st.st_size) < detail::HEADER_SIZE) {
+                close(fd);
+                throw std::runtime_error(file + " is not a serialized file");
+            }
+            size_ = static_cast<size_t>(st.st_size);
+            void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            int error = errno;
+            close(fd);
+            if (data == MAP_FAILED)
+                throw std::system_error(error, std::system_category(), file);
+            data_ = static_cast<char const*>(data);
+            try {
+                detail::check_header<T>(file, data_);
+            } catch (...) {
+                munmap(const_cast<char*>(data_), size_);
+                throw;
+            }
+        }
+
+        mapped_file(mapped_file&& other) : data_{ other.data_ }, size_{ other.size_ } {
+            other.data_ = nullptr;
+            other.size_ = 0;
+        }
+
+        mapped_file(mapped_file const&) = delete;
+        mapped_file& operator=(mapped_file const&) = delete;
+
+        ~mapped_file() {
+            if (data_ != nullptr) {
+                munmap(const_cast<char*>(data_), size_);
+            }
+        }
+
+        view_t<T> root() const {
+            return view_t<T>{ data_ + detail::HEADER_SIZE, data_ + size_ };
+        }
+
+        size_t size() const {
+            return size_;
+        }
+    };
+
+}
+
+#endif //TMP_MAPPED_FILE_H
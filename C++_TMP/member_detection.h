@@ -5,9 +5,12 @@
 #ifndef TMP_MEMBER_DETECTION_H
 #define TMP_MEMBER_DETECTION_H
 
+#include <iostream>
 #include <vector>
 #include <string>
 
+#include "common.h"
+
 namespace member_detection {
 
     namespace detail {
@@ -89,6 +92,19 @@ namespace member_detection {
     template <typename T>
     using is_container4 = bool_t<detail::is_container4_helper<T>(0)>;
 
+    // is_container3 with the fixes from lab4: strings are values, built-in arrays are containers
+    template <typename T>
+    struct is_container : is_container3<T> {
+    };
+
+    template <typename CharT, typename Traits, typename Allocator>
+    struct is_container<std::basic_string<CharT, Traits, Allocator>> : false_t {
+    };
+
+    template <typename T, size_t N>
+    struct is_container<T[N]> : true_t {
+    };
+
     template <template <typename> class Detector>
     void test() {
         static_assert(!Detector<int>::value, "");
@@ -0,0 +1,77 @@
+#ifndef TMP_PARALLEL_SEARCH_H
+#define TMP_PARALLEL_SEARCH_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+
+#include "iterators.h"
+#include "linear_search.h"
+#include "solutions.h"
+#include "thread_pool.h"
+
+// The multithreaded overload of solutions::lab3::linear_search, which searches on the shared thread pool
+namespace solutions {
+
+    namespace lab3 {
+
+        struct multithreaded_t {};
+        constexpr multithreaded_t multithreaded{};
+
+        // Vectorized ranges of at least this many elements are searched on the shared thread pool
+        constexpr size_t PARALLEL_SEARCH_THRESHOLD = 1024 * 1024;
+
+        namespace detail {
+
+            template <typename It, typename T>
+            It parallel_search(It first, It last, T const& val, false_t) {
+                return linear_search(first, last, val);
+            }
+
+            // The range is cut into chunks that are handed out in order. Chunks that start after a match
+            // that was already found are skipped, so the search stops soon after the first match.
+            template <typename It, typename T>
+            It parallel_search(It first, It last, T const& val, true_t) {
+                using E = std::decay_t<decltype(*first)>;
+                size_t n = static_cast<size_t>(last - first);
+                E key;
+                if (n < PARALLEL_SEARCH_THRESHOLD || !search_key(val, key))
+                    return linear_search(first, last, val);
+
+                E const* p = traits::detail::to_address(first);
+                size_t chunk_size = PARALLEL_SEARCH_THRESHOLD / 4;
+                std::atomic<size_t> found{ n };
+                ::parallel::thread_pool::shared().parallel_for((n + chunk_size - 1) / chunk_size, [&](size_t c) {
+                    size_t begin = c * chunk_size;
+                    if (begin >= found.load(std::memory_order_relaxed))
+                        return;
+                    size_t size = std::min(chunk_size, n - begin);
+                    size_t index = find_kernel(p + begin, size, key);
+                    if (index == size)
+                        return;
+                    size_t match = begin + index;
+                    size_t current = found.load(std::memory_order_relaxed);
+                    while (match < current && !found.compare_exchange_weak(current, match, std::memory_order_relaxed))
+                        ;
+                });
+                return first + found.load();
+            }
+
+        }
+
+        // Like linear_search, but splits large contiguous arithmetic ranges across threads; other ranges
+        // are searched on the calling thread
+        template <typename It, typename T>
+        It linear_search(It first, It last, T const& val, multithreaded_t) {
+            using decayed_it_t = std::decay_t<decltype(*first)>;
+            static_assert(has_eq_operator<T, decayed_it_t>(0),
+                          "'val' must have an equality operator with elements of the sequence (==)");
+
+            return detail::parallel_search(first, last, val, is_vectorizable_search_t<It, T>{});
+        }
+
+    }
+
+}
+
+#endif //TMP_PARALLEL_SEARCH_H
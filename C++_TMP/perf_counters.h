@@ -0,0 +1,341 @@
+#ifndef TMP_PERF_COUNTERS_H
+#define TMP_PERF_COUNTERS_H
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Scoped hardware counter instrumentation. A region is a named scope; every time it is left, the cycles,
+// instructions, cache misses and branch misses spent inside it are added to the calling thread's totals
+// for that name. Which counters are used is a compile-time policy: with no_counters_policy a region is an
+// empty object whose constructor and destructor do nothing, so instrumented code costs nothing.
+namespace perfcounters {
+
+    enum counter { cycles, instructions, cache_misses, branch_misses, COUNTER_COUNT };
+
+    struct counter_values {
+        uint64_t values[COUNTER_COUNT] = {};
+
+        uint64_t operator[](counter c) const {
+            return values[c];
+        }
+
+        counter_values& operator+=(counter_values const& other) {
+            for (int c = 0; c < COUNTER_COUNT; ++c) {
+                values[c] += other.values[c];
+            }
+            return *this;
+        }
+
+        counter_values operator-(counter_values const& other) const {
+            counter_values result;
+            for (int c = 0; c < COUNTER_COUNT; ++c) {
+                result.values[c] = values[c] - other.values[c];
+            }
+            return result;
+        }
+    };
+
+    char const* counter_name(counter c) {
+        static char const* names[] = { "cycles", "instructions", "cache_misses", "branch_misses" };
+        return names[c];
+    }
+
+    struct region_stats {
+        std::string name;
+        uint64_t calls = 0;
+        counter_values totals;
+    };
+
+    struct thread_stats {
+        pid_t tid = 0;
+        // False once the thread has exited; its totals are kept
+        bool alive = true;
+        // False if the kernel refused to open the counters for this thread, in which case only calls are counted
+        bool counting = false;
+        std::vector<region_stats> regions;
+    };
+
+    namespace detail {
+
+        // The counters of one thread, opened as a single group so that they are read together
+        class event_group {
+            int fds_[COUNTER_COUNT];
+            // Position of each counter in a group read, or -1 if it couldn't be opened
+            int slots_[COUNTER_COUNT];
+            int leader_ = -1;
+            int opened_ = 0;
+
+            static int open_event(uint64_t config, int group_fd) {
+                perf_event_attr attr;
+                std::memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = config;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+                // Counts the calling thread only, on whatever CPU it runs
+                return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0));
+            }
+
+        public:
+            event_group() {
+                static uint64_t const configs[COUNTER_COUNT] = {
+                        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+                };
+                for (int c = 0; c < COUNTER_COUNT; ++c) {
+                    fds_[c] = open_event(configs[c], leader_);
+                    slots_[c] = fds_[c] < 0 ? -1 : opened_++;
+                    if (leader_ < 0) {
+                        leader_ = fds_[c];
+                    }
+                }
+            }
+
+            event_group(event_group const&) = delete;
+            event_group& operator=(event_group const&) = delete;
+
+            ~event_group() {
+                for (int fd : fds_) {
+                    if (fd >= 0) {
+                        close(fd);
+                    }
+                }
+            }
+
+            bool counting() const {
+                return opened_ != 0;
+            }
+
+            // Current counts, scaled up when the kernel had to multiplex the counters; zeros if not counting
+            counter_values read() const {
+                counter_values result;
+                if (!counting())
+                    return result;
+                uint64_t buffer[3 + COUNTER_COUNT];
+                if (::read(leader_, buffer, sizeof(buffer)) < static_cast<ssize_t>((3 + opened_) * sizeof(uint64_t)))
+                    return result;
+                uint64_t enabled = buffer[1], running = buffer[2];
+                for (int c = 0; c < COUNTER_COUNT; ++c) {
+                    if (slots_[c] < 0)
+                        continue;
+                    uint64_t value = buffer[3 + slots_[c]];
+                    result.values[c] = running == 0 || running == enabled
+                                       ? value
+                                       : static_cast<uint64_t>(static_cast<double>(value) * enabled / running);
+                }
+                return result;
+            }
+        };
+
+        struct thread_record {
+            std::mutex lock;
+            pid_t tid = 0;
+            bool alive = true;
+            bool counting = false;
+            // std::less<> lets regions be looked up by the literal name without building a string
+            std::map<std::string, region_stats, std::less<>> regions;
+        };
+
+        // Every thread that ever entered a hardware-counted region, including the ones that have exited
+        class registry {
+            std::mutex lock_;
+            std::vector<std::shared_ptr<thread_record>> threads_;
+
+        public:
+            void add(std::shared_ptr<thread_record> record) {
+                std::lock_guard<std::mutex> guard{ lock_ };
+                threads_.push_back(std::move(record));
+            }
+
+            std::vector<std::shared_ptr<thread_record>> threads() {
+                std::lock_guard<std::mutex> guard{ lock_ };
+                return threads_;
+            }
+
+            static registry& shared() {
+                static registry instance;
+                return instance;
+            }
+        };
+
+        // The calling thread's counters and totals, created on its first region
+        class thread_state {
+            event_group events_;
+            std::shared_ptr<thread_record> record_ = std::make_shared<thread_record>();
+
+        public:
+            thread_state() {
+                record_->tid = static_cast<pid_t>(syscall(SYS_gettid));
+                record_->counting = events_.counting();
+                registry::shared().add(record_);
+            }
+
+            ~thread_state() {
+                std::lock_guard<std::mutex> guard{ record_->lock };
+                record_->alive = false;
+            }
+
+            counter_values read() const {
+                return events_.read();
+            }
+
+            bool counting() const {
+                return events_.counting();
+            }
+
+            void add(char const* name, counter_values const& delta) {
+                std::lock_guard<std::mutex> guard{ record_->lock };
+                auto it = record_->regions.find(name);
+                if (it == record_->regions.end()) {
+                    it = record_->regions.emplace(name, region_stats{}).first;
+                    it->second.name = name;
+                }
+                ++it->second.calls;
+                it->second.totals += delta;
+            }
+
+            static thread_state& current() {
+                thread_local thread_state state;
+                return state;
+            }
+        };
+
+    }
+
+    // Reads the calling thread's hardware counters around each region
+    struct hardware_counters_policy {
+        constexpr static bool enabled = true;
+        using token = counter_values;
+
+        // Whether the calling thread's counters could be opened; if not, every count reads as zero
+        static bool counting() {
+            return detail::thread_state::current().counting();
+        }
+
+        static token start() {
+            return detail::thread_state::current().read();
+        }
+
+        // Adds the counts since start to the region's totals and returns them
+        static counter_values stop(char const* name, token const& start) {
+            auto& state = detail::thread_state::current();
+            counter_values delta = state.read() - start;
+            state.add(name, delta);
+            return delta;
+        }
+    };
+
+    struct no_counters_policy {
+        constexpr static bool enabled = false;
+        struct token {};
+
+        static bool counting() {
+            return false;
+        }
+
+        static token start() {
+            return token{};
+        }
+
+        static counter_values stop(char const*, token) {
+            return counter_values{};
+        }
+    };
+
+    template <typename CountersPolicy>
+    class scoped_region {
+        char const* name_;
+        typename CountersPolicy::token start_;
+    public:
+        // The name is kept by pointer until the region ends
+        explicit scoped_region(char const* name) : name_{ name }, start_{ CountersPolicy::start() } {
+        }
+
+        scoped_region(scoped_region const&) = delete;
+        scoped_region& operator=(scoped_region const&) = delete;
+
+        ~scoped_region() {
+            CountersPolicy::stop(name_, start_);
+        }
+    };
+
+    template <>
+    class scoped_region<no_counters_policy> {
+    public:
+        explicit scoped_region(char const*) {
+        }
+    };
+
+    // Building with TMP_PERF_COUNTERS defined turns on the regions that use the default policy
+#ifdef TMP_PERF_COUNTERS
+    using default_policy = hardware_counters_policy;
+#else
+    using default_policy = no_counters_policy;
+#endif
+
+    using region = scoped_region<default_policy>;
+
+    // The totals of every thread so far; safe to call while other threads are inside regions
+    std::vector<thread_stats> snapshot() {
+        std::vector<thread_stats> result;
+        for (auto const& record : detail::registry::shared().threads()) {
+            std::lock_guard<std::mutex> guard{ record->lock };
+            thread_stats stats;
+            stats.tid = record->tid;
+            stats.alive = record->alive;
+            stats.counting = record->counting;
+            for (auto const& region : record->regions) {
+                stats.regions.push_back(region.second);
+            }
+            result.push_back(std::move(stats));
+        }
+        return result;
+    }
+
+    // The totals of every region summed over all threads
+    std::vector<region_stats> merged(std::vector<thread_stats> const& threads) {
+        std::map<std::string, region_stats> merged;
+        for (auto const& thread : threads) {
+            for (auto const& region : thread.regions) {
+                auto& total = merged[region.name];
+                total.name = region.name;
+                total.calls += region.calls;
+                total.totals += region.totals;
+            }
+        }
+        std::vector<region_stats> result;
+        for (auto const& region : merged) {
+            result.push_back(region.second);
+        }
+        return result;
+    }
+
+    void write_report(std::ostream& out, std::vector<thread_stats> const& threads) {
+        for (auto const& thread : threads) {
+            out << "thread " << thread.tid << (thread.alive ? "" : " (exited)")
+                << (thread.counting ? "" : " (no hardware counters)") << '\n';
+            for (auto const& region : thread.regions) {
+                out << "  " << region.name << ": calls=" << region.calls;
+                for (int c = 0; c < COUNTER_COUNT; ++c) {
+                    out << ' ' << counter_name(static_cast<counter>(c)) << '=' << region.totals.values[c];
+                }
+                out << '\n';
+            }
+        }
+    }
+
+}
+
+#endif //TMP_PERF_COUNTERS_H
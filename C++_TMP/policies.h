@@ -5,11 +5,38 @@
 #ifndef TMP_POLICIES_H
 #define TMP_POLICIES_H
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <random>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "common.h"
 
 namespace policies {
 
-    template <typename T, typename SafetyPolicy>
+    struct delete_policy;
+
+    // Owns the pointee and releases it through AllocationPolicy::destroy, so the pointer must have come from
+    // the same policy (from new for delete_policy); make_smart_ptr allocates through the policy
+    template <typename T, typename SafetyPolicy, typename AllocationPolicy = delete_policy>
     class smart_ptr {
         T* ptr_;
     public:
@@ -17,6 +44,24 @@ namespace policies {
             SafetyPolicy::test(ptr);
         }
 
+        smart_ptr(smart_ptr const&) = delete;
+        smart_ptr& operator=(smart_ptr const&) = delete;
+
+        smart_ptr(smart_ptr&& other) : ptr_{ other.ptr_ } {
+            other.ptr_ = nullptr;
+        }
+
+        // The old pointee is destroyed here rather than handed to 'other'
+        smart_ptr& operator=(smart_ptr&& other) {
+            if (this != &other) {
+                T* old = ptr_;
+                ptr_ = other.ptr_;
+                other.ptr_ = nullptr;
+                AllocationPolicy::destroy(old);
+            }
+            return *this;
+        }
+
         T& operator*() {
             SafetyPolicy::test(ptr_);
             return *ptr_;
@@ -27,13 +72,19 @@ namespace policies {
             return *ptr_;
         }
 
+        T* get() const {
+            return ptr_;
+        }
+
         void reset(T* ptr) {
-            SafetyPolicy::test(ptr_);
+            SafetyPolicy::test(ptr);
+            T* old = ptr_;
             ptr_ = ptr;
+            AllocationPolicy::destroy(old);
         }
 
         ~smart_ptr() {
-            delete ptr_;
+            AllocationPolicy::destroy(ptr_);
         }
     };
 
@@ -49,12 +100,1254 @@ namespace policies {
         }
     };
 
+    // Every object is a separate general-purpose heap allocation
+    struct delete_policy {
+        template <typename T, typename... Args>
+        static T* create(Args&&... args) {
+            return new T(std::forward<Args>(args)...);
+        }
+
+        template <typename T>
+        static void destroy(T* ptr) {
+            delete ptr;
+        }
+    };
+
+    namespace detail {
+
+        constexpr size_t POOL_GRANULE = 16;
+        constexpr size_t POOL_MAX_SIZE = 256;
+        constexpr size_t POOL_CLASSES = POOL_MAX_SIZE / POOL_GRANULE;
+        constexpr size_t POOL_SLAB_SIZE = 64 * 1024;
+        // Blocks move between a thread's cache and the depot this many at a time
+        constexpr size_t POOL_BATCH = 64;
+
+        struct free_block {
+            free_block* next;
+        };
+
+        // Whether a T is served by the pool rather than by operator new
+        template <typename T>
+        using is_pooled_t = bool_t<sizeof(T) <= POOL_MAX_SIZE && alignof(T) <= POOL_GRANULE>;
+
+        // Free blocks given up by threads that exited or had too many, shared by the process. Slabs are never
+        // returned to the system: blocks freed on one thread are reused by whichever thread takes them next.
+        class pool_depot {
+            std::mutex lock_;
+            std::vector<std::pair<free_block*, size_t>> lists_[POOL_CLASSES];
+
+        public:
+            void give(size_t size_class, free_block* list, size_t count) {
+                std::lock_guard<std::mutex> guard{ lock_ };
+                lists_[size_class].emplace_back(list, count);
+            }
+
+            // A list of free blocks and its length, or nullptr if there is none
+            std::pair<free_block*, size_t> take(size_t size_class) {
+                std::lock_guard<std::mutex> guard{ lock_ };
+                auto& lists = lists_[size_class];
+                if (lists.empty())
+                    return { nullptr, 0 };
+                auto list = lists.back();
+                lists.pop_back();
+                return list;
+            }
+
+            static pool_depot& shared() {
+                static pool_depot depot;
+                return depot;
+            }
+        };
+
+        // Set once the calling thread's cache is destroyed; later frees on that thread go to the depot
+        thread_local bool pool_cache_destroyed = false;
+
+        // The calling thread's free lists, one per size class; no locking except to refill from the depot
+        class pool_cache {
+            free_block* lists_[POOL_CLASSES] = {};
+            size_t counts_[POOL_CLASSES] = {};
+            char* slab_next_ = nullptr;
+            char* slab_end_ = nullptr;
+
+            void refill(size_t size_class) {
+                auto list = pool_depot::shared().take(size_class);
+                if (list.first != nullptr) {
+                    lists_[size_class] = list.first;
+                    counts_[size_class] = list.second;
+                    return;
+                }
+
+                size_t block_size = (size_class + 1) * POOL_GRANULE;
+                for (size_t i = 0; i < POOL_BATCH; ++i) {
+                    if (slab_next_ + block_size > slab_end_) {
+                        slab_next_ = static_cast<char*>(::operator new(POOL_SLAB_SIZE));
+                        slab_end_ = slab_next_ + POOL_SLAB_SIZE;
+                    }
+                    auto block = reinterpret_cast<free_block*>(slab_next_);
+                    slab_next_ += block_size;
+                    block->next = lists_[size_class];
+                    lists_[size_class] = block;
+                    ++counts_[size_class];
+                }
+            }
+
+        public:
+            pool_cache() = default;
+            pool_cache(pool_cache const&) = delete;
+            pool_cache& operator=(pool_cache const&) = delete;
+
+            ~pool_cache() {
+                for (size_t c = 0; c < POOL_CLASSES; ++c) {
+                    if (lists_[c] != nullptr) {
+                        pool_depot::shared().give(c, lists_[c], counts_[c]);
+                    }
+                }
+                pool_cache_destroyed = true;
+            }
+
+            void* allocate(size_t size) {
+                size_t size_class = (size - 1) / POOL_GRANULE;
+                if (lists_[size_class] == nullptr) {
+                    refill(size_class);
+                }
+                free_block* block = lists_[size_class];
+                lists_[size_class] = block->next;
+                --counts_[size_class];
+                return block;
+            }
+
+            void deallocate(void* ptr, size_t size) {
+                size_t size_class = (size - 1) / POOL_GRANULE;
+                auto block = static_cast<free_block*>(ptr);
+                block->next = lists_[size_class];
+                lists_[size_class] = block;
+                // A thread that frees what others allocate hands the surplus back instead of hoarding it
+                if (++counts_[size_class] >= 2 * POOL_BATCH) {
+                    free_block* surplus = block;
+                    for (size_t i = 1; i < POOL_BATCH; ++i) {
+                        block = block->next;
+                    }
+                    lists_[size_class] = block->next;
+                    block->next = nullptr;
+                    counts_[size_class] -= POOL_BATCH;
+                    pool_depot::shared().give(size_class, surplus, POOL_BATCH);
+                }
+            }
+
+            static pool_cache& current() {
+                thread_local pool_cache cache;
+                return cache;
+            }
+        };
+
+        void* pool_allocate(size_t size, true_t) {
+            return pool_cache::current().allocate(size);
+        }
+
+        void* pool_allocate(size_t size, false_t) {
+            return ::operator new(size);
+        }
+
+        void pool_deallocate(void* ptr, size_t size, true_t) {
+            if (pool_cache_destroyed) {
+                auto block = static_cast<free_block*>(ptr);
+                block->next = nullptr;
+                pool_depot::shared().give((size - 1) / POOL_GRANULE, block, 1);
+            } else {
+                pool_cache::current().deallocate(ptr, size);
+            }
+        }
+
+        void pool_deallocate(void* ptr, size_t, false_t) {
+            ::operator delete(ptr);
+        }
+
+    }
+
+    // Small objects come from per-thread free lists of fixed-size blocks, rounded up to 16 bytes; objects over
+    // 256 bytes or with stricter alignment fall back to operator new. An object may be freed on any thread.
+    // Blocks are returned by the static type's size, so a T with a virtual destructor must be final: a pointer
+    // to a base class could otherwise free a derived object into the wrong size class.
+    struct pool_policy {
+        template <typename T, typename... Args>
+        static T* create(Args&&... args) {
+            void* memory = detail::pool_allocate(sizeof(T), detail::is_pooled_t<T>{});
+            try {
+                return new (memory) T(std::forward<Args>(args)...);
+            } catch (...) {
+                detail::pool_deallocate(memory, sizeof(T), detail::is_pooled_t<T>{});
+                throw;
+            }
+        }
+
+        template <typename T>
+        static void destroy(T* ptr) {
+            static_assert(!std::has_virtual_destructor<T>::value || std::is_final<T>::value,
+                          "pool_policy can't free a derived object through a base pointer; make T final");
+            if (ptr == nullptr)
+                return;
+            ptr->~T();
+            detail::pool_deallocate(ptr, sizeof(T), detail::is_pooled_t<T>{});
+        }
+    };
+
+    // Hands out memory by bumping a pointer through large blocks and releases it all at once. Constructing an
+    // arena makes it the calling thread's current arena until it is destroyed, which is where arena_policy
+    // allocates; arenas nest. Objects in it must be destroyed before the arena is reset or destroyed.
+    class arena {
+        std::vector<std::unique_ptr<char[]>> blocks_;
+        size_t block_size_;
+        char* next_ = nullptr;
+        char* end_ = nullptr;
+        arena* previous_;
+
+        static arena*& top() {
+            thread_local arena* current = nullptr;
+            return current;
+        }
+
+    public:
+        explicit arena(size_t block_size = 64 * 1024) : block_size_{ block_size }, previous_{ top() } {
+            top() = this;
+        }
+
+        arena(arena const&) = delete;
+        arena& operator=(arena const&) = delete;
+
+        ~arena() {
+            top() = previous_;
+        }
+
+        void* allocate(size_t size, size_t alignment) {
+            auto aligned = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(next_) + alignment - 1) & ~(alignment - 1));
+            if (next_ == nullptr || aligned + size > end_) {
+                size_t capacity = std::max(block_size_, size + alignment);
+                blocks_.emplace_back(new char[capacity]);
+                next_ = blocks_.back().get();
+                end_ = next_ + capacity;
+                aligned = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(next_) + alignment - 1) & ~(alignment - 1));
+            }
+            next_ = aligned + size;
+            return aligned;
+        }
+
+        // Makes all the memory available again, keeping the first block
+        void reset() {
+            if (blocks_.empty())
+                return;
+            blocks_.resize(1);
+            next_ = blocks_[0].get();
+            end_ = next_ + block_size_;
+        }
+
+        static arena& current() {
+            if (top() == nullptr) {
+                throw std::logic_error("no arena on this thread");
+            }
+            return *top();
+        }
+    };
+
+    // Allocates from the calling thread's current arena; destroying an object runs its destructor only
+    struct arena_policy {
+        template <typename T, typename... Args>
+        static T* create(Args&&... args) {
+            return new (arena::current().allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        }
+
+        template <typename T>
+        static void destroy(T* ptr) {
+            if (ptr != nullptr) {
+                ptr->~T();
+            }
+        }
+    };
+
+    template <typename T, typename SafetyPolicy = unsafe_policy, typename AllocationPolicy = delete_policy, typename... Args>
+    smart_ptr<T, SafetyPolicy, AllocationPolicy> make_smart_ptr(Args&&... args) {
+        return smart_ptr<T, SafetyPolicy, AllocationPolicy>{ AllocationPolicy::template create<T>(std::forward<Args>(args)...) };
+    }
+
     template <typename T>
     using unsafe_ptr = smart_ptr<T, unsafe_policy>;
 
     template <typename T>
     using non_null_ptr = smart_ptr<T, non_null_policy>;
 
+    template <typename T>
+    using pooled_ptr = smart_ptr<T, unsafe_policy, pool_policy>;
+
+    template <typename T>
+    using arena_ptr = smart_ptr<T, unsafe_policy, arena_policy>;
+
+    namespace detail {
+
+        // The reference count of a counted_ptr's object and how to release the object once it drops to zero.
+        // It is either a base of the object itself (intrusive) or allocated next to or apart from it.
+        template <typename ThreadingPolicy>
+        struct control_block {
+            typename ThreadingPolicy::counter count;
+            void (*release)(control_block*) = nullptr;
+        };
+
+    }
+
+    // For use from one thread only: the count is a plain integer
+    struct single_threaded_policy {
+        struct counter {
+            size_t refs = 1;
+        };
+
+        template <typename Block>
+        static void increment(Block& block) {
+            ++block.count.refs;
+        }
+
+        // True if that was the last reference and the object must be released
+        template <typename Block>
+        static bool decrement(Block& block) {
+            return --block.count.refs == 0;
+        }
+
+        template <typename Block>
+        static size_t use_count(Block const& block) {
+            return block.count.refs;
+        }
+    };
+
+    // Every copy and release is an atomic read-modify-write, as with std::shared_ptr
+    struct multi_threaded_policy {
+        struct counter {
+            std::atomic<size_t> refs{ 1 };
+        };
+
+        template <typename Block>
+        static void increment(Block& block) {
+            block.count.refs.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        template <typename Block>
+        static bool decrement(Block& block) {
+            return block.count.refs.fetch_sub(1, std::memory_order_acq_rel) == 1;
+        }
+
+        template <typename Block>
+        static size_t use_count(Block const& block) {
+            return block.count.refs.load(std::memory_order_relaxed);
+        }
+    };
+
+    // Biased reference counting: the thread that created the object counts its references with plain
+    // arithmetic, and only other threads pay for atomics. When the owner's count reaches zero it merges its
+    // count into the shared one. When another thread's release drives the shared count below zero, the
+    // object is queued to the owner, which merges it the next time it copies or releases any biased_policy
+    // pointer, or calls collect(). Until then an object whose last reference was dropped elsewhere stays
+    // allocated.
+    struct biased_policy {
+        struct counter;
+        using block_type = detail::control_block<biased_policy>;
+
+        // Objects waiting for their owner to merge them. One per thread that creates biased objects, never
+        // freed, so that its address identifies the owner even after the thread has exited.
+        class owner_queue {
+            std::mutex lock_;
+            std::vector<block_type*> pending_;
+            std::atomic<bool> has_pending_{ false };
+            bool exited_ = false;
+
+            struct exit_handler {
+                owner_queue* queue;
+
+                ~exit_handler() {
+                    std::lock_guard<std::mutex> guard{ queue->lock_ };
+                    queue->exited_ = true;
+                    queue->drain_locked();
+                }
+            };
+
+            void drain_locked() {
+                std::vector<block_type*> pending;
+                pending.swap(pending_);
+                has_pending_.store(false, std::memory_order_relaxed);
+                for (block_type* block : pending) {
+                    merge(*block);
+                }
+            }
+
+        public:
+            // Called by other threads; merges the object itself if the owner has already exited
+            void push(block_type* block) {
+                std::lock_guard<std::mutex> guard{ lock_ };
+                if (exited_) {
+                    merge(*block);
+                    return;
+                }
+                pending_.push_back(block);
+                has_pending_.store(true, std::memory_order_release);
+            }
+
+            void drain() {
+                if (!has_pending_.load(std::memory_order_acquire))
+                    return;
+                std::lock_guard<std::mutex> guard{ lock_ };
+                drain_locked();
+            }
+
+            // The calling thread's queue, or nullptr if it hasn't created a biased object yet
+            static owner_queue*& existing() {
+                thread_local owner_queue* queue = nullptr;
+                return queue;
+            }
+
+            static owner_queue* current() {
+                owner_queue*& queue = existing();
+                if (queue == nullptr) {
+                    queue = new owner_queue;
+                    thread_local exit_handler handler{ queue };
+                    (void)handler;
+                }
+                return queue;
+            }
+        };
+
+        // The shared count holds the other threads' references above two flag bits, and may go negative
+        constexpr static intptr_t MERGED = 1, QUEUED = 2, ONE = 4;
+
+        struct counter {
+            owner_queue* owner = owner_queue::current();
+            size_t biased = 1;
+            bool merged = false;
+            std::atomic<intptr_t> shared{ 0 };
+        };
+
+        // Moves the owner's references into the shared count; the object is released if none are left
+        static void merge(block_type& block) {
+            intptr_t add = block.count.merged ? 0 : static_cast<intptr_t>(block.count.biased) * ONE + MERGED;
+            block.count.biased = 0;
+            block.count.merged = true;
+            block.count.shared.fetch_add(add, std::memory_order_acq_rel);
+            intptr_t now = block.count.shared.fetch_and(~QUEUED, std::memory_order_acq_rel) & ~QUEUED;
+            if (now == MERGED) {
+                block.release(&block);
+            }
+        }
+
+        static void increment(block_type& block) {
+            owner_queue* owner = block.count.owner;
+            if (owner == owner_queue::existing()) {
+                owner->drain();
+                if (!block.count.merged) {
+                    ++block.count.biased;
+                    return;
+                }
+            }
+            block.count.shared.fetch_add(ONE, std::memory_order_relaxed);
+        }
+
+        static bool decrement(block_type& block) {
+            owner_queue* owner = block.count.owner;
+            if (owner == owner_queue::existing()) {
+                // Draining first may merge this very object, after which the owner counts atomically too
+                owner->drain();
+                if (!block.count.merged) {
+                    if (--block.count.biased != 0)
+                        return false;
+                    block.count.merged = true;
+                    // Released here only if no other thread holds it and it isn't waiting in the queue
+                    return block.count.shared.fetch_or(MERGED, std::memory_order_acq_rel) == 0;
+                }
+            }
+
+            intptr_t now = block.count.shared.fetch_sub(ONE, std::memory_order_acq_rel) - ONE;
+            if (now == MERGED)
+                return true;
+            if (now < 0 && (now & (MERGED | QUEUED)) == 0 &&
+                (block.count.shared.fetch_or(QUEUED, std::memory_order_acq_rel) & QUEUED) == 0) {
+                owner->push(&block);
+            }
+            return false;
+        }
+
+        // Approximate unless called by the owner with no other thread copying or releasing the object
+        static size_t use_count(block_type const& block) {
+            intptr_t others = (block.count.shared.load(std::memory_order_relaxed) & ~(MERGED | QUEUED)) / ONE;
+            return static_cast<size_t>(static_cast<intptr_t>(block.count.biased) + others);
+        }
+
+        // Merges the objects queued to the calling thread, releasing the ones no one references any more
+        static void collect() {
+            if (owner_queue::existing() != nullptr) {
+                owner_queue::existing()->drain();
+            }
+        }
+    };
+
+    // Deriving from ref_counted puts the reference count inside the object, so counted_ptr needs no separate
+    // control block for it and can be re-created from a plain pointer with counted_ptr::share
+    template <typename ThreadingPolicy>
+    class ref_counted : public detail::control_block<ThreadingPolicy> {
+    public:
+        ref_counted() = default;
+
+        // A copy of the object is a new object with its own count
+        ref_counted(ref_counted const&) : detail::control_block<ThreadingPolicy>{} {
+        }
+
+        ref_counted& operator=(ref_counted const&) {
+            return *this;
+        }
+    };
+
+    namespace detail {
+
+        template <typename T, typename ThreadingPolicy>
+        using is_intrusive_t = bool_t<std::is_base_of<ref_counted<ThreadingPolicy>, T>::value>;
+
+        // The control block make_counted_ptr allocates together with the object
+        template <typename T, typename ThreadingPolicy>
+        struct inline_block : control_block<ThreadingPolicy> {
+            T value;
+
+            template <typename... Args>
+            inline_block(Args&&... args) : value(std::forward<Args>(args)...) {
+            }
+        };
+
+        // The control block for a non-intrusive object that was allocated on its own
+        template <typename T, typename ThreadingPolicy>
+        struct separate_block : control_block<ThreadingPolicy> {
+            T* ptr;
+
+            separate_block(T* ptr) : ptr{ ptr } {
+            }
+        };
+
+    }
+
+    // Shared ownership of an object allocated through AllocationPolicy, with the reference count kept according
+    // to ThreadingPolicy, and SafetyPolicy applied on construction and dereference as in smart_ptr
+    template <typename T, typename SafetyPolicy, typename ThreadingPolicy, typename AllocationPolicy = delete_policy>
+    class counted_ptr {
+        using block_type = detail::control_block<ThreadingPolicy>;
+
+        T* ptr_ = nullptr;
+        block_type* block_ = nullptr;
+
+        counted_ptr(T* ptr, block_type* block) : ptr_{ ptr }, block_{ block } {
+            SafetyPolicy::test(ptr);
+        }
+
+        static block_type* adopt(T* ptr, true_t) {
+            block_type* block = ptr;
+            block->release = [](block_type* b) { AllocationPolicy::destroy(static_cast<T*>(b)); };
+            return block;
+        }
+
+        static block_type* adopt(T* ptr, false_t) {
+            using block = detail::separate_block<T, ThreadingPolicy>;
+            block* result;
+            try {
+                result = AllocationPolicy::template create<block>(ptr);
+            } catch (...) {
+                AllocationPolicy::destroy(ptr);
+                throw;
+            }
+            result->release = [](block_type* b) {
+                auto self = static_cast<block*>(b);
+                AllocationPolicy::destroy(self->ptr);
+                AllocationPolicy::destroy(self);
+            };
+            return result;
+        }
+
+        template <typename... Args>
+        static counted_ptr make_helper(true_t, Args&&... args) {
+            return counted_ptr{ AllocationPolicy::template create<T>(std::forward<Args>(args)...) };
+        }
+
+        template <typename... Args>
+        static counted_ptr make_helper(false_t, Args&&... args) {
+            using block = detail::inline_block<T, ThreadingPolicy>;
+            block* result = AllocationPolicy::template create<block>(std::forward<Args>(args)...);
+            result->release = [](block_type* b) { AllocationPolicy::destroy(static_cast<block*>(b)); };
+            return counted_ptr{ &result->value, result };
+        }
+
+        void release() {
+            if (block_ != nullptr && ThreadingPolicy::decrement(*block_)) {
+                block_->release(block_);
+            }
+        }
+
+    public:
+        // Takes ownership of an object that came from AllocationPolicy (from new for delete_policy)
+        counted_ptr(T* ptr) : counted_ptr{ ptr, ptr ? adopt(ptr, detail::is_intrusive_t<T, ThreadingPolicy>{}) : nullptr } {
+        }
+
+        counted_ptr(counted_ptr const& other) : ptr_{ other.ptr_ }, block_{ other.block_ } {
+            if (block_ != nullptr) {
+                ThreadingPolicy::increment(*block_);
+            }
+        }
+
+        counted_ptr(counted_ptr&& other) : ptr_{ other.ptr_ }, block_{ other.block_ } {
+            other.ptr_ = nullptr;
+            other.block_ = nullptr;
+        }
+
+        counted_ptr& operator=(counted_ptr other) {
+            std::swap(ptr_, other.ptr_);
+            std::swap(block_, other.block_);
+            return *this;
+        }
+
+        ~counted_ptr() {
+            release();
+        }
+
+        // Another reference to an intrusively counted object that is already owned by a counted_ptr
+        template <typename U = T>
+        static typename allow_if_t<detail::is_intrusive_t<U, ThreadingPolicy>::value, counted_ptr>::type share(U* ptr) {
+            ThreadingPolicy::increment(*static_cast<block_type*>(ptr));
+            return counted_ptr{ ptr, ptr };
+        }
+
+        template <typename... Args>
+        static counted_ptr make(Args&&... args) {
+            return make_helper(detail::is_intrusive_t<T, ThreadingPolicy>{}, std::forward<Args>(args)...);
+        }
+
+        T& operator*() const {
+            SafetyPolicy::test(ptr_);
+            return *ptr_;
+        }
+
+        T* operator->() const {
+            SafetyPolicy::test(ptr_);
+            return ptr_;
+        }
+
+        T* get() const {
+            return ptr_;
+        }
+
+        explicit operator bool() const {
+            return ptr_ != nullptr;
+        }
+
+        size_t use_count() const {
+            return block_ != nullptr ? ThreadingPolicy::use_count(*block_) : 0;
+        }
+
+        void reset(T* ptr) {
+            counted_ptr{ ptr }.swap(*this);
+        }
+
+        void swap(counted_ptr& other) {
+            std::swap(ptr_, other.ptr_);
+            std::swap(block_, other.block_);
+        }
+    };
+
+    // Allocates the object and, unless it is ref_counted, its count as a single allocation
+    template <typename T, typename SafetyPolicy = unsafe_policy, typename ThreadingPolicy = multi_threaded_policy,
+              typename AllocationPolicy = delete_policy, typename... Args>
+    counted_ptr<T, SafetyPolicy, ThreadingPolicy, AllocationPolicy> make_counted_ptr(Args&&... args) {
+        return counted_ptr<T, SafetyPolicy, ThreadingPolicy, AllocationPolicy>::make(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    using local_ptr = counted_ptr<T, unsafe_policy, single_threaded_policy>;
+
+    template <typename T>
+    using atomic_counted_ptr = counted_ptr<T, unsafe_policy, multi_threaded_policy>;
+
+    template <typename T>
+    using biased_ptr = counted_ptr<T, unsafe_policy, biased_policy>;
+
+    namespace detail {
+
+        // An object that was unlinked from an atomic_ptr and is waiting until no reader can still see it
+        struct retired_object {
+            void* ptr;
+            void (*destroy)(void*);
+            uint64_t epoch;
+        };
+
+        // Per-thread records of a reclamation policy, in a list that only grows. A thread claims a free record
+        // the first time it needs one and gives it back when it exits; objects it retired and couldn't free yet
+        // stay in the record and are freed by whichever thread claims it next.
+        template <typename Record>
+        class thread_records {
+            static std::atomic<Record*>& head() {
+                static std::atomic<Record*> first{ nullptr };
+                return first;
+            }
+
+            static Record* claim() {
+                for (Record* r = head().load(std::memory_order_acquire); r != nullptr; r = r->next) {
+                    bool free = false;
+                    if (r->in_use.compare_exchange_strong(free, true, std::memory_order_acquire))
+                        return r;
+                }
+                auto r = new Record;
+                r->in_use.store(true, std::memory_order_relaxed);
+                r->next = head().load(std::memory_order_relaxed);
+                while (!head().compare_exchange_weak(r->next, r, std::memory_order_release)) {
+                }
+                return r;
+            }
+
+            struct owner {
+                Record* record = claim();
+
+                ~owner() {
+                    Record::reclaim(*record);
+                    record->in_use.store(false, std::memory_order_release);
+                }
+            };
+
+        public:
+            static Record& mine() {
+                thread_local owner me;
+                return *me.record;
+            }
+
+            template <typename Fn>
+            static void for_each(Fn fn) {
+                for (Record* r = head().load(std::memory_order_acquire); r != nullptr; r = r->next) {
+                    fn(*r);
+                }
+            }
+        };
+
+    }
+
+    // Epoch-based reclamation. Readers announce the global epoch they started in, which costs a store and a
+    // fence and never waits. An unlinked object is stamped with the epoch it was retired in and freed once
+    // the global epoch has moved two past it, which it can only do after every reader has moved on.
+    struct epoch_policy {
+        struct record {
+            // The epoch the thread is reading in, or 0 outside of any read
+            std::atomic<uint64_t> epoch{ 0 };
+            std::atomic<bool> in_use{ false };
+            record* next = nullptr;
+            unsigned depth = 0;
+            std::vector<detail::retired_object> retired;
+
+            static void reclaim(record& r) {
+                collect(r);
+            }
+        };
+
+        using records = detail::thread_records<record>;
+
+        static std::atomic<uint64_t>& global_epoch() {
+            static std::atomic<uint64_t> epoch{ 1 };
+            return epoch;
+        }
+
+        // Moves the global epoch forward if every thread that is reading has seen the current one
+        static void try_advance() {
+            uint64_t current = global_epoch().load(std::memory_order_seq_cst);
+            bool all_current = true;
+            records::for_each([&](record& r) {
+                uint64_t epoch = r.epoch.load(std::memory_order_seq_cst);
+                all_current = all_current && (epoch == 0 || epoch == current);
+            });
+            if (all_current) {
+                global_epoch().compare_exchange_strong(current, current + 1, std::memory_order_seq_cst);
+            }
+        }
+
+        static void collect(record& r) {
+            try_advance();
+            uint64_t current = global_epoch().load(std::memory_order_seq_cst);
+            auto safe = std::partition(r.retired.begin(), r.retired.end(),
+                                       [=](detail::retired_object const& o) { return o.epoch + 2 > current; });
+            std::vector<detail::retired_object> expired(safe, r.retired.end());
+            r.retired.erase(safe, r.retired.end());
+            for (auto const& o : expired) {
+                o.destroy(o.ptr);
+            }
+        }
+
+        class guard {
+            record* record_;
+        public:
+            guard() : record_{ &records::mine() } {
+                if (record_->depth++ == 0) {
+                    record_->epoch.store(global_epoch().load(std::memory_order_relaxed), std::memory_order_seq_cst);
+                    // Orders the announcement before the loads in protect; without it a writer's scan could
+                    // miss the announcement while this thread still loads the pointer the writer replaced
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                }
+            }
+
+            guard(guard&& other) : record_{ other.record_ } {
+                other.record_ = nullptr;
+            }
+
+            guard(guard const&) = delete;
+            guard& operator=(guard const&) = delete;
+
+            ~guard() {
+                if (record_ != nullptr && --record_->depth == 0) {
+                    record_->epoch.store(0, std::memory_order_release);
+                }
+            }
+
+            template <typename T>
+            T* protect(std::atomic<T*> const& source) {
+                return source.load(std::memory_order_acquire);
+            }
+        };
+
+        static void retire(void* ptr, void (*destroy)(void*)) {
+            record& r = records::mine();
+            r.retired.push_back({ ptr, destroy, global_epoch().load(std::memory_order_seq_cst) });
+            collect(r);
+        }
+
+        // Frees what the calling thread retired, as far as readers allow; true if nothing is left
+        static bool flush() {
+            record& r = records::mine();
+            for (int i = 0; i < 3 && !r.retired.empty(); ++i) {
+                collect(r);
+            }
+            return r.retired.empty();
+        }
+    };
+
+    // Hazard pointers. A reader publishes the pointer it is about to use in one of its thread's slots and
+    // re-reads the source to check it wasn't replaced in between, so a read retries under contention rather
+    // than being wait-free, but a stalled reader can only hold back the objects it points to.
+    struct hazard_pointer_policy {
+        // Guards a thread can hold at the same time
+        constexpr static size_t SLOTS = 4;
+
+        struct record {
+            std::atomic<void*> hazards[SLOTS] = {};
+            // Which slots belong to a live guard; guards can be released in any order
+            bool claimed[SLOTS] = {};
+            std::atomic<bool> in_use{ false };
+            record* next = nullptr;
+            std::vector<detail::retired_object> retired;
+
+            static void reclaim(record& r) {
+                collect(r);
+            }
+        };
+
+        using records = detail::thread_records<record>;
+
+        static void collect(record& r) {
+            std::vector<void*> hazards;
+            records::for_each([&](record& other) {
+                for (auto const& hazard : other.hazards) {
+                    if (void* ptr = hazard.load(std::memory_order_seq_cst)) {
+                        hazards.push_back(ptr);
+                    }
+                }
+            });
+            std::sort(hazards.begin(), hazards.end());
+            auto safe = std::partition(r.retired.begin(), r.retired.end(), [&](detail::retired_object const& o) {
+                return std::binary_search(hazards.begin(), hazards.end(), o.ptr);
+            });
+            std::vector<detail::retired_object> expired(safe, r.retired.end());
+            r.retired.erase(safe, r.retired.end());
+            for (auto const& o : expired) {
+                o.destroy(o.ptr);
+            }
+        }
+
+        class guard {
+            record* record_;
+            std::atomic<void*>* slot_;
+        public:
+            guard() : record_{ &records::mine() } {
+                auto free = std::find(std::begin(record_->claimed), std::end(record_->claimed), false);
+                if (free == std::end(record_->claimed)) {
+                    throw std::logic_error("too many hazard pointers held by this thread");
+                }
+                *free = true;
+                slot_ = &record_->hazards[free - std::begin(record_->claimed)];
+            }
+
+            guard(guard&& other) : record_{ other.record_ }, slot_{ other.slot_ } {
+                other.record_ = nullptr;
+            }
+
+            guard(guard const&) = delete;
+            guard& operator=(guard const&) = delete;
+
+            ~guard() {
+                if (record_ != nullptr) {
+                    slot_->store(nullptr, std::memory_order_release);
+                    record_->claimed[slot_ - record_->hazards] = false;
+                }
+            }
+
+            template <typename T>
+            T* protect(std::atomic<T*> const& source) {
+                T* ptr = source.load(std::memory_order_relaxed);
+                for (;;) {
+                    slot_->store(ptr, std::memory_order_seq_cst);
+                    T* again = source.load(std::memory_order_seq_cst);
+                    if (again == ptr)
+                        return ptr;
+                    ptr = again;
+                }
+            }
+        };
+
+        static void retire(void* ptr, void (*destroy)(void*)) {
+            record& r = records::mine();
+            r.retired.push_back({ ptr, destroy, 0 });
+            collect(r);
+        }
+
+        static bool flush() {
+            record& r = records::mine();
+            collect(r);
+            return r.retired.empty();
+        }
+    };
+
+    // A pointer that one thread replaces while many read it. Replaced objects are retired through
+    // ReclamationPolicy and freed through AllocationPolicy once no reader can still be using them.
+    template <typename T, typename ReclamationPolicy = epoch_policy, typename AllocationPolicy = delete_policy>
+    class atomic_ptr {
+        std::atomic<T*> ptr_;
+
+        static void destroy(void* ptr) {
+            AllocationPolicy::destroy(static_cast<T*>(ptr));
+        }
+
+    public:
+        // Keeps the object it was loaded with alive for as long as it exists
+        class reader {
+            typename ReclamationPolicy::guard guard_;
+            T const* ptr_;
+        public:
+            explicit reader(std::atomic<T*> const& source) : ptr_{ guard_.protect(source) } {
+            }
+
+            T const* get() const {
+                return ptr_;
+            }
+
+            T const& operator*() const {
+                return *ptr_;
+            }
+
+            T const* operator->() const {
+                return ptr_;
+            }
+
+            explicit operator bool() const {
+                return ptr_ != nullptr;
+            }
+        };
+
+        // Takes ownership of an object that came from AllocationPolicy (from new for delete_policy)
+        explicit atomic_ptr(T* ptr = nullptr) : ptr_{ ptr } {
+        }
+
+        atomic_ptr(atomic_ptr const&) = delete;
+        atomic_ptr& operator=(atomic_ptr const&) = delete;
+
+        // No reader may be left; objects retired earlier are freed by the policy as usual
+        ~atomic_ptr() {
+            AllocationPolicy::destroy(ptr_.load(std::memory_order_relaxed));
+        }
+
+        reader read() const {
+            return reader{ ptr_ };
+        }
+
+        // Publishes the new object and retires the one it replaces. The exchange is sequentially consistent so
+        // that the policy's scan of the readers can't be ordered before it.
+        void store(T* ptr) {
+            T* old = ptr_.exchange(ptr, std::memory_order_seq_cst);
+            if (old != nullptr) {
+                ReclamationPolicy::retire(old, &atomic_ptr::destroy);
+            }
+        }
+
+        template <typename... Args>
+        void emplace(Args&&... args) {
+            store(AllocationPolicy::template create<T>(std::forward<Args>(args)...));
+        }
+    };
+
+    namespace tests {
+
+        template <size_t Size>
+        struct payload {
+            char data[Size];
+        };
+
+        template <typename Make>
+        void add_sharing_benchmarks(bench::runner& runner, std::string const& description, Make make) {
+            runner.add("shared/" + description + "/make+release", [=] {
+                auto p = make();
+                bench::do_not_optimize(p);
+            });
+            runner.add("shared/" + description + "/copy+release", [p = make()] {
+                auto copy = p;
+                bench::do_not_optimize(copy);
+            });
+        }
+
+        struct routing_table {
+            std::vector<int> routes;
+
+            explicit routing_table(int version) : routes(64, version) {
+            }
+        };
+
+        // The status quo the atomic_ptr replaces: a mutex around a shared_ptr
+        class locked_table {
+            mutable std::mutex lock_;
+            std::shared_ptr<routing_table const> table_ = std::make_shared<routing_table>(0);
+        public:
+            int lookup(size_t route) const {
+                std::lock_guard<std::mutex> guard{ lock_ };
+                return table_->routes[route];
+            }
+
+            void replace(int version) {
+                std::shared_ptr<routing_table const> table = std::make_shared<routing_table>(version);
+                std::lock_guard<std::mutex> guard{ lock_ };
+                table_.swap(table);
+            }
+        };
+
+        template <typename ReclamationPolicy>
+        class published_table {
+            atomic_ptr<routing_table, ReclamationPolicy> table_{ new routing_table(0) };
+        public:
+            int lookup(size_t route) const {
+                return table_.read()->routes[route];
+            }
+
+            void replace(int version) {
+                table_.emplace(version);
+            }
+        };
+
+        // Replaces randomly chosen objects in windows of live 16-, 64- and 200-byte objects, the churn that
+        // fragments a general-purpose heap. The arena can't free individual objects, so its windows are
+        // emptied and the arena reset whenever every slot has been replaced once.
+        template <typename AllocationPolicy>
+        void churn(size_t operations, size_t window, bool reset_arena) {
+            using small_ptr = smart_ptr<payload<16>, unsafe_policy, AllocationPolicy>;
+            using medium_ptr = smart_ptr<payload<64>, unsafe_policy, AllocationPolicy>;
+            using large_ptr = smart_ptr<payload<200>, unsafe_policy, AllocationPolicy>;
+
+            std::unique_ptr<arena> local_arena{ reset_arena ? new arena{ 1024 * 1024 } : nullptr };
+            std::vector<small_ptr> small;
+            std::vector<medium_ptr> medium;
+            std::vector<large_ptr> large;
+            for (size_t i = 0; i < window; ++i) {
+                small.push_back(make_smart_ptr<payload<16>, unsafe_policy, AllocationPolicy>());
+                medium.push_back(make_smart_ptr<payload<64>, unsafe_policy, AllocationPolicy>());
+                large.push_back(make_smart_ptr<payload<200>, unsafe_policy, AllocationPolicy>());
+            }
+
+            std::minstd_rand random{ 42 };
+            for (size_t i = 0; i < operations; ++i) {
+                if (reset_arena && i % window == window - 1) {
+                    small.clear();
+                    medium.clear();
+                    large.clear();
+                    local_arena->reset();
+                }
+                size_t slot = random() % window;
+                switch (i % 3) {
+                    case 0:
+                        if (slot < small.size()) small[slot] = make_smart_ptr<payload<16>, unsafe_policy, AllocationPolicy>();
+                        else small.push_back(make_smart_ptr<payload<16>, unsafe_policy, AllocationPolicy>());
+                        break;
+                    case 1:
+                        if (slot < medium.size()) medium[slot] = make_smart_ptr<payload<64>, unsafe_policy, AllocationPolicy>();
+                        else medium.push_back(make_smart_ptr<payload<64>, unsafe_policy, AllocationPolicy>());
+                        break;
+                    default:
+                        if (slot < large.size()) large[slot] = make_smart_ptr<payload<200>, unsafe_policy, AllocationPolicy>();
+                        else large.push_back(make_smart_ptr<payload<200>, unsafe_policy, AllocationPolicy>());
+                        break;
+                }
+            }
+            small.clear();
+            medium.clear();
+            large.clear();
+        }
+
+        // Runs the churn on 'threads' threads in a child process, so the peak RSS reported by the kernel
+        // belongs to this policy alone
+        template <typename AllocationPolicy>
+        void measure_churn(char const* description, unsigned threads, bool reset_arena) {
+            constexpr size_t OPERATIONS = 2000000, WINDOW = 50000;
+            std::cout << std::flush;
+            pid_t pid = fork();
+            if (pid < 0)
+                throw std::runtime_error("fork failed");
+            if (pid == 0) {
+                auto start = std::chrono::steady_clock::now();
+                std::vector<std::thread> workers;
+                for (unsigned t = 0; t < threads; ++t) {
+                    workers.emplace_back([=] { churn<AllocationPolicy>(OPERATIONS, WINDOW, reset_arena); });
+                }
+                for (auto& worker : workers) {
+                    worker.join();
+                }
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                std::printf("%-8s %2u thr  %8.2f Mops/s", description, threads, OPERATIONS * threads / seconds / 1e6);
+                std::fflush(stdout);
+                _exit(0);
+            }
+            int status;
+            rusage usage;
+            if (wait4(pid, &status, 0, &usage) < 0)
+                throw std::runtime_error("wait4 failed");
+            std::printf("  peak RSS %8ld KB\n", usage.ru_maxrss);
+        }
+
+        void add_benchmarks(bench::runner& runner) {
+            runner.add("smart_ptr/delete_policy/make+destroy", [] {
+                auto p = make_smart_ptr<payload<64>>();
+                bench::do_not_optimize(p);
+            });
+            runner.add("smart_ptr/pool_policy/make+destroy", [] {
+                auto p = make_smart_ptr<payload<64>, unsafe_policy, pool_policy>();
+                bench::do_not_optimize(p);
+            });
+            // The arena is current only inside the body, so nothing else on the thread allocates from it
+            runner.add("smart_ptr/arena_policy/4096 make+destroy", [] {
+                arena a;
+                for (int i = 0; i < 4096; ++i) {
+                    auto p = make_smart_ptr<payload<64>, unsafe_policy, arena_policy>();
+                    bench::do_not_optimize(p);
+                }
+            });
+
+            add_sharing_benchmarks(runner, "counted_ptr/single_threaded", make_counted_ptr<payload<64>, unsafe_policy, single_threaded_policy>);
+            add_sharing_benchmarks(runner, "counted_ptr/multi_threaded", make_counted_ptr<payload<64>, unsafe_policy, multi_threaded_policy>);
+            add_sharing_benchmarks(runner, "counted_ptr/biased", make_counted_ptr<payload<64>, unsafe_policy, biased_policy>);
+            add_sharing_benchmarks(runner, "std::shared_ptr", std::make_shared<payload<64>>);
+        }
+
+        // Runs 'work' on 'count' new threads until destroyed, handing it the flag that says when to return
+        class contending_threads {
+            std::atomic<bool> stop_{ false };
+            std::vector<std::thread> threads_;
+        public:
+            template <typename Work>
+            contending_threads(unsigned count, Work work) {
+                for (unsigned t = 0; t < count; ++t) {
+                    threads_.emplace_back([this, work] { work(stop_); });
+                }
+            }
+
+            contending_threads(contending_threads const&) = delete;
+            contending_threads& operator=(contending_threads const&) = delete;
+
+            ~contending_threads() {
+                stop_ = true;
+                for (auto& thread : threads_) {
+                    thread.join();
+                }
+            }
+        };
+
+        // Lookups on the calling thread while 'readers - 1' other threads look up too and one writer replaces
+        // the table every 100us
+        template <typename Table>
+        void measure_reads(std::string const& description, unsigned readers) {
+            Table table;
+            contending_threads writer{ 1, [&](std::atomic<bool> const& stop) {
+                for (int version = 1; !stop.load(std::memory_order_relaxed); ++version) {
+                    table.replace(version);
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                }
+            } };
+            contending_threads others{ readers - 1, [&](std::atomic<bool> const& stop) {
+                int sum = 0;
+                for (size_t i = 0; !stop.load(std::memory_order_relaxed); ++i) {
+                    sum += table.lookup(i % 64);
+                }
+                bench::do_not_optimize(sum);
+            } };
+
+            bench::runner runner;
+            runner.add("routing_table/" + description + "/" + std::to_string(readers) + " readers/lookup",
+                       [&table, i = size_t{ 0 }]() mutable {
+                           bench::do_not_optimize(table.lookup(i++ % 64));
+                       });
+            runner.run();
+        }
+
+        // Copies and releases of the pointer on the calling thread while 'threads - 1' other threads do the same.
+        // Either each of the others copies an object it made itself, or all of them copy the calling thread's.
+        template <typename Make>
+        void measure_sharing(std::string const& description, unsigned threads, bool one_object, Make make) {
+            auto shared = make();
+            contending_threads others{ threads - 1, [&](std::atomic<bool> const& stop) {
+                auto ptr = one_object ? shared : make();
+                while (!stop.load(std::memory_order_relaxed)) {
+                    auto copy = ptr;
+                    bench::do_not_optimize(copy);
+                }
+            } };
+
+            bench::runner runner;
+            runner.add("shared/" + description + (one_object ? "/one object/" : "/own object/") +
+                       std::to_string(threads) + " threads/copy+release", [&shared] {
+                auto copy = shared;
+                bench::do_not_optimize(copy);
+            });
+            runner.run();
+        }
+
+    }
+
+    void allocation_perf() {
+        unsigned max_threads = std::max(2u, std::thread::hardware_concurrency());
+        for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+            tests::measure_churn<delete_policy>("delete", threads, false);
+            tests::measure_churn<pool_policy>("pool", threads, false);
+            tests::measure_churn<arena_policy>("arena", threads, true);
+        }
+
+        bench::runner runner;
+        tests::add_benchmarks(runner);
+        runner.run();
+    }
+
+    void read_scaling_perf() {
+        unsigned max_threads = std::max(2u, std::thread::hardware_concurrency());
+        for (unsigned readers = 1; readers <= max_threads; readers *= 2) {
+            tests::measure_reads<tests::locked_table>("mutex", readers);
+            tests::measure_reads<tests::published_table<epoch_policy>>("epoch_policy", readers);
+            tests::measure_reads<tests::published_table<hazard_pointer_policy>>("hazard_pointer_policy", readers);
+        }
+    }
+
+    void sharing_perf() {
+        unsigned max_threads = std::max(2u, std::thread::hardware_concurrency());
+        for (bool one_object : { false, true }) {
+            for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+                tests::measure_sharing("counted_ptr/multi_threaded", threads, one_object,
+                                       make_counted_ptr<tests::payload<64>, unsafe_policy, multi_threaded_policy>);
+                tests::measure_sharing("counted_ptr/biased", threads, one_object,
+                                       make_counted_ptr<tests::payload<64>, unsafe_policy, biased_policy>);
+                tests::measure_sharing("std::shared_ptr", threads, one_object, std::make_shared<tests::payload<64>>);
+            }
+        }
+    }
+
 }
 
 #endif //TMP_POLICIES_H
@@ -0,0 +1,295 @@
+#ifndef TMP_RANGE_REDUCTIONS_H
+#define TMP_RANGE_REDUCTIONS_H
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <cstring>
+#include <initializer_list>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "common.h"
+#include "compile_time_computation.h"
+#include "simd.h"
+#include "thread_pool.h"
+
+namespace compiletime {
+
+    // A contiguous, read-only run of elements to reduce
+    template <typename T>
+    struct reduce_span {
+        T const* data;
+        size_t size;
+    };
+
+    template <typename T>
+    reduce_span<T> make_span(T const* data, size_t size) {
+        return { data, size };
+    }
+
+    template <typename T>
+    reduce_span<T> make_span(T const* first, T const* last) {
+        return { first, static_cast<size_t>(last - first) };
+    }
+
+    template <typename T>
+    struct minmax_result {
+        T min;
+        T max;
+    };
+
+    // Ranges with at least this many elements are split across the shared thread pool
+    constexpr size_t PARALLEL_REDUCE_THRESHOLD = 1024 * 1024;
+
+    namespace detail {
+
+        template <typename T>
+        struct reducible_t : bool_t<integral_t<T>::value || std::is_floating_point<T>::value> {};
+
+        template <typename T>
+        reduce_span<T> as_span(reduce_span<T> span) {
+            return span;
+        }
+
+        template <typename T, size_t N>
+        reduce_span<T> as_span(T const(&arr)[N]) {
+            return { arr, N };
+        }
+
+        template <typename Container>
+        auto as_span(Container const& c) -> reduce_span<std::remove_cv_t<std::remove_pointer_t<decltype(c.data())>>> {
+            return { c.data(), c.size() };
+        }
+
+        template <typename Range>
+        using span_value_t = std::remove_cv_t<std::remove_pointer_t<decltype(as_span(val_of_t<Range const&>()).data)>>;
+
+        // A register's worth of To elements, loaded from as many (possibly narrower) T elements
+        template <typename To, typename T>
+        typename simd<To>::type load_as(T const* p) {
+            typedef T narrow __attribute__((vector_size(sizeof(T) * simd<To>::LANES)));
+            narrow v;
+            std::memcpy(&v, p, sizeof(v));
+            return __builtin_convertvector(v, typename simd<To>::type);
+        }
+
+        // Each kernel keeps four independent accumulators, so consecutive iterations don't wait on each other
+
+        // Elements are widened to Acc before they are added, so narrow types don't wrap around
+        template <typename Acc, typename T>
+        Acc sum_kernel(T const* p, size_t n) {
+            using vec = typename simd<Acc>::type;
+            constexpr size_t L = simd<Acc>::LANES;
+            vec acc0 = {}, acc1 = {}, acc2 = {}, acc3 = {};
+            size_t i = 0;
+            for (; i + 4 * L <= n; i += 4 * L) {
+                acc0 += load_as<Acc>(p + i);
+                acc1 += load_as<Acc>(p + i + L);
+                acc2 += load_as<Acc>(p + i + 2 * L);
+                acc3 += load_as<Acc>(p + i + 3 * L);
+            }
+            vec acc = (acc0 + acc1) + (acc2 + acc3);
+            Acc result = 0;
+            for (size_t lane = 0; lane < L; ++lane) {
+                result += acc[lane];
+            }
+            for (; i < n; ++i) {
+                result += static_cast<Acc>(p[i]);
+            }
+            return result;
+        }
+
+        // n must not be zero
+        template <typename T>
+        minmax_result<T> minmax_kernel(T const* p, size_t n) {
+            using vec = typename simd<T>::type;
+            constexpr size_t L = simd<T>::LANES;
+            size_t i = 0;
+            minmax_result<T> result{ p[0], p[0] };
+            if (n >= 4 * L) {
+                vec min0 = load(p), min1 = load(p + L), min2 = load(p + 2 * L), min3 = load(p + 3 * L);
+                vec max0 = min0, max1 = min1, max2 = min2, max3 = min3;
+                for (i = 4 * L; i + 4 * L <= n; i += 4 * L) {
+                    vec v0 = load(p + i), v1 = load(p + i + L), v2 = load(p + i + 2 * L), v3 = load(p + i + 3 * L);
+                    min0 = v0 < min0 ? v0 : min0;
+                    min1 = v1 < min1 ? v1 : min1;
+                    min2 = v2 < min2 ? v2 : min2;
+                    min3 = v3 < min3 ? v3 : min3;
+                    max0 = v0 > max0 ? v0 : max0;
+                    max1 = v1 > max1 ? v1 : max1;
+                    max2 = v2 > max2 ? v2 : max2;
+                    max3 = v3 > max3 ? v3 : max3;
+                }
+                min0 = min1 < min0 ? min1 : min0;
+                min2 = min3 < min2 ? min3 : min2;
+                min0 = min2 < min0 ? min2 : min0;
+                max0 = max1 > max0 ? max1 : max0;
+                max2 = max3 > max2 ? max3 : max2;
+                max0 = max2 > max0 ? max2 : max0;
+                for (size_t lane = 0; lane < L; ++lane) {
+                    result.min = std::min(result.min, static_cast<T>(min0[lane]));
+                    result.max = std::max(result.max, static_cast<T>(max0[lane]));
+                }
+            }
+            for (; i < n; ++i) {
+                result.min = std::min(result.min, p[i]);
+                result.max = std::max(result.max, p[i]);
+            }
+            return result;
+        }
+
+        // Added up in Sum, or in T when that is wider (a floating point range with an integral Sum)
+        template <typename Sum, typename T>
+        Sum sum_of(reduce_span<T> span) {
+            using Acc = decltype(val_of_t<Sum>() + val_of_t<T>());
+            if (span.size < PARALLEL_REDUCE_THRESHOLD)
+                return static_cast<Sum>(sum_kernel<Acc>(span.data, span.size));
+
+            auto& pool = parallel::thread_pool::shared();
+            size_t chunks = std::min<size_t>(pool.size() + 1, span.size / (PARALLEL_REDUCE_THRESHOLD / 4));
+            size_t chunk_size = (span.size + chunks - 1) / chunks;
+            std::vector<Acc> partial(chunks);
+            pool.parallel_for(chunks, [&](size_t c) {
+                size_t first = c * chunk_size;
+                partial[c] = sum_kernel<Acc>(span.data + first, std::min(chunk_size, span.size - first));
+            });
+            return static_cast<Sum>(sum_kernel<Acc>(partial.data(), partial.size()));
+        }
+
+        // span.size must not be zero
+        template <typename T>
+        minmax_result<T> minmax_of(reduce_span<T> span) {
+            if (span.size < PARALLEL_REDUCE_THRESHOLD)
+                return minmax_kernel(span.data, span.size);
+
+            auto& pool = parallel::thread_pool::shared();
+            size_t chunks = std::min<size_t>(pool.size() + 1, span.size / (PARALLEL_REDUCE_THRESHOLD / 4));
+            size_t chunk_size = (span.size + chunks - 1) / chunks;
+            std::vector<minmax_result<T>> partial(chunks);
+            pool.parallel_for(chunks, [&](size_t c) {
+                size_t first = c * chunk_size;
+                partial[c] = minmax_kernel(span.data + first, std::min(chunk_size, span.size - first));
+            });
+            minmax_result<T> result = partial[0];
+            for (auto const& p : partial) {
+                result.min = std::min(result.min, p.min);
+                result.max = std::max(result.max, p.max);
+            }
+            return result;
+        }
+
+        template <typename Largest, typename T>
+        void accumulate_minmax(minmax_result<Largest>& result, bool& any, reduce_span<T> span) {
+            if (span.size == 0)
+                return;
+            auto mm = minmax_of(span);
+            Largest min = static_cast<Largest>(mm.min), max = static_cast<Largest>(mm.max);
+            result.min = any ? std::min(result.min, min) : min;
+            result.max = any ? std::max(result.max, max) : max;
+            any = true;
+        }
+
+        template <typename... Ranges>
+        using reduce_result_t = typename largest_t<span_value_t<Ranges>...>::type;
+
+        // Like adding two elements of the result type: integers narrower than int are added up as int
+        template <typename... Ranges>
+        using sum_result_t = decltype(val_of_t<reduce_result_t<Ranges...>>() + val_of_t<reduce_result_t<Ranges...>>());
+
+        template <typename... Ranges>
+        using allow_if_reducible_t = allow_if_t<and_f<reducible_t, span_value_t<Ranges>...>()>;
+
+    }
+
+    // Reductions over one or more contiguous ranges (containers with data() and size(), built-in arrays, or
+    // make_span results). The minimum and maximum have the type that varmax would pick for one element of each
+    // range, and each range is scanned in its own element type. Sums are added up in that type too, promoted
+    // to int if it is narrower, and every element is widened to it before it is added, so a range of short or
+    // char doesn't wrap around. Sums of floating point ranges are added up in a different order than a
+    // sequential loop would use, so they may differ from it in the last bits.
+
+    template <typename... Ranges, typename = detail::allow_if_reducible_t<Ranges...>>
+    auto range_sum(Ranges const&... ranges) {
+        using sum_type = detail::sum_result_t<Ranges...>;
+        std::initializer_list<sum_type> sums{ detail::sum_of<sum_type>(detail::as_span(ranges))... };
+        sum_type result = 0;
+        for (auto sum : sums) {
+            result += sum;
+        }
+        return result;
+    }
+
+    // Throws std::invalid_argument if all the ranges are empty
+    template <typename... Ranges, typename = detail::allow_if_reducible_t<Ranges...>>
+    auto range_minmax(Ranges const&... ranges) {
+        using largest = detail::reduce_result_t<Ranges...>;
+        minmax_result<largest> result{};
+        bool any = false;
+        int expand[] = { 0, (detail::accumulate_minmax(result, any, detail::as_span(ranges)), 0)... };
+        (void)expand;
+        if (!any)
+            throw std::invalid_argument("can't find the minimum or maximum of empty ranges");
+        return result;
+    }
+
+    template <typename... Ranges, typename = detail::allow_if_reducible_t<Ranges...>>
+    auto range_min(Ranges const&... ranges) {
+        return range_minmax(ranges...).min;
+    }
+
+    template <typename... Ranges, typename = detail::allow_if_reducible_t<Ranges...>>
+    auto range_max(Ranges const&... ranges) {
+        return range_minmax(ranges...).max;
+    }
+
+    namespace tests {
+
+        template <typename Fn>
+        void measure_reduction(std::string const& description, size_t count, Fn fn) {
+            size_t iterations = std::max<size_t>(1, (size_t{ 64 } << 20) / count);
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t i = 0; i < iterations; ++i) {
+                fn();
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            double seconds = std::chrono::duration<double>(end - start).count();
+            std::cout << "[" << description << " " << count << " elements] "
+                      << (static_cast<double>(count) * iterations / seconds / 1e6) << " M elements/s\n";
+        }
+
+        template <typename T>
+        void reductions_perf() {
+            std::mt19937 random;
+            std::uniform_int_distribution<int> dist{ 0, 100 };
+            std::vector<T> values(16 * 1024 * 1024);
+            for (auto& v : values) {
+                v = static_cast<T>(dist(random));
+            }
+            volatile T result{};
+            for (size_t count = 1024; count <= values.size(); count *= 16) {
+                auto first = values.data(), last = values.data() + count;
+                measure_reduction("std::accumulate  ", count, [&] { result = std::accumulate(first, last, T{}); });
+                measure_reduction("range_sum        ", count, [&] { result = range_sum(make_span(first, last)); });
+                measure_reduction("std::max_element ", count, [&] { result = *std::max_element(first, last); });
+                measure_reduction("range_max        ", count, [&] { result = range_max(make_span(first, last)); });
+                measure_reduction("std::minmax      ", count, [&] { result = std::minmax_element(first, last).first[0]; });
+                measure_reduction("range_minmax     ", count, [&] { result = range_minmax(make_span(first, last)).min; });
+            }
+        }
+
+    }
+
+    void range_reductions_perf() {
+        tests::reductions_perf<int>();
+        tests::reductions_perf<float>();
+        tests::reductions_perf<double>();
+    }
+
+}
+
+#endif //TMP_RANGE_REDUCTIONS_H
@@ -5,8 +5,11 @@
 #ifndef TMP_SEQUENCES_H
 #define TMP_SEQUENCES_H
 
+#include <initializer_list>
 #include <tuple>
 
+#include "common.h"
+#include "type_lists.h"
 #include "variadics.h"
 
 namespace sequences {
@@ -33,18 +36,191 @@ namespace sequences {
         using type = int_seq<Head..., Tail>;
     };
 
+    namespace detail {
+
+        // Appends a copy of the sequence shifted by its length, plus one more element when Odd is set
+        template <typename, bool Odd>
+        struct double_seq;
+
+        template <size_t... Ns>
+        struct double_seq<int_seq<Ns...>, false> : int_seq<Ns..., (sizeof...(Ns) + Ns)...> {};
+
+        template <size_t... Ns>
+        struct double_seq<int_seq<Ns...>, true> : int_seq<Ns..., (sizeof...(Ns) + Ns)..., 2 * sizeof...(Ns)> {};
+
+        template <typename Seqs, typename Pairs>
+        struct concat_pairs;
+
+    }
+
+    // 0, 1, ..., N-1, built by doubling so the instantiation depth is O(log N)
     template <size_t N>
-    struct make_seq {
-        using type = typename push_back_seq<N, typename make_seq<N-1>::type>::type;
-    };
+    struct iota_seq : detail::double_seq<typename iota_seq<N / 2>::type, N % 2 == 1> {};
 
     template <>
-    struct make_seq<0> {
-        using type = int_seq<0>;
-    };
+    struct iota_seq<0> : int_seq<> {};
+
+    template <>
+    struct iota_seq<1> : int_seq<0> {};
+
+    // 0, 1, ..., N
+    template <size_t N>
+    struct make_seq : iota_seq<N + 1> {};
 
     template <size_t N>
-    using make_index_seq = typename make_seq<N-1>::type;
+    using make_index_seq = typename iota_seq<N>::type;
+
+    namespace detail {
+
+        template <size_t I, typename>
+        struct repeat_impl;
+
+        template <size_t I, size_t... Ns>
+        struct repeat_impl<I, int_seq<Ns...>> : int_seq<(0 * Ns + I)...> {};
+
+    }
+
+    // I repeated N times
+    template <size_t I, size_t N>
+    struct repeat_seq : detail::repeat_impl<I, make_index_seq<N>> {};
+
+    // Adds K to every element
+    template <size_t K, typename>
+    struct offset_seq;
+
+    template <size_t K, size_t... Ns>
+    struct offset_seq<K, int_seq<Ns...>> : int_seq<(Ns + K)...> {};
+
+    // Concatenates any number of int_seqs by merging neighbouring pairs, so the depth is O(log(number of sequences))
+    template <typename... Seqs>
+    struct concat_seq : detail::concat_pairs<typelists::type_list<Seqs...>, make_index_seq<sizeof...(Seqs) / 2>> {};
+
+    template <>
+    struct concat_seq<> : int_seq<> {};
+
+    template <size_t... Ns>
+    struct concat_seq<int_seq<Ns...>> : int_seq<Ns...> {};
+
+    template <size_t... Ns, size_t... Ms>
+    struct concat_seq<int_seq<Ns...>, int_seq<Ms...>> : int_seq<Ns..., Ms...> {};
+
+    namespace detail {
+
+        template <typename... Seqs, size_t... Is>
+        struct concat_pairs<typelists::type_list<Seqs...>, int_seq<Is...>>
+                : concat_seq<typename concat_seq<typelists::at_t<2 * Is, Seqs...>, typelists::at_t<2 * Is + 1, Seqs...>>::type...,
+                             typename select_t<sizeof...(Seqs) % 2 == 1,
+                                               typelists::at<sizeof...(Seqs) - 1, Seqs...>,
+                                               is<int_seq<>>>::type::type> {};
+
+        // Holders expose the elements of a sequence through a static at(i). Gathering through a single Holder
+        // parameter keeps every lookup cheap; naming the whole pack once per element makes it quadratic.
+        template <size_t... Ns>
+        struct seq_values {
+            constexpr static size_t values[sizeof...(Ns) + 1] = { Ns..., 0 };
+            constexpr static size_t at(size_t i) { return values[i]; }
+        };
+
+        template <typename Holder, typename Indices>
+        struct gather_impl;
+
+        template <typename Holder, size_t... Is>
+        struct gather_impl<Holder, int_seq<Is...>> : int_seq<Holder::at(Is)...> {};
+
+        template <size_t N>
+        struct value_array {
+            size_t values[N + 1];
+        };
+
+        constexpr size_t count_kept(std::initializer_list<bool> keep) {
+            size_t count = 0;
+            for (bool flag : keep) {
+                count += flag ? 1 : 0;
+            }
+            return count;
+        }
+
+        template <size_t Count>
+        constexpr value_array<Count> kept_values(std::initializer_list<size_t> values, std::initializer_list<bool> keep) {
+            value_array<Count> result{};
+            size_t next = 0;
+            auto flag = keep.begin();
+            for (size_t value : values) {
+                if (*flag++) {
+                    result.values[next++] = value;
+                }
+            }
+            return result;
+        }
+
+        template <template <size_t> class Pred, size_t... Ns>
+        struct filtered_values {
+            constexpr static size_t COUNT = count_kept({ bool(Pred<Ns>::value)... });
+            constexpr static value_array<COUNT> VALUES = kept_values<COUNT>({ Ns... }, { bool(Pred<Ns>::value)... });
+            constexpr static size_t at(size_t i) { return VALUES.values[i]; }
+        };
+
+        template <size_t Last, typename>
+        struct reverse_indices;
+
+        template <size_t Last, size_t... Is>
+        struct reverse_indices<Last, int_seq<Is...>> : int_seq<(Last - Is)...> {};
+
+    }
+
+    template <typename>
+    struct reverse_seq;
+
+    template <size_t... Ns>
+    struct reverse_seq<int_seq<Ns...>>
+            : detail::gather_impl<detail::seq_values<Ns...>,
+                                  typename detail::reverse_indices<sizeof...(Ns) - 1, make_index_seq<sizeof...(Ns)>>::type> {};
+
+    // The elements N for which Pred<N>::value is true, in their original order
+    template <template <size_t> class Pred, typename>
+    struct filter_seq;
+
+    template <template <size_t> class Pred, size_t... Ns>
+    struct filter_seq<Pred, int_seq<Ns...>>
+            : detail::gather_impl<detail::filtered_values<Pred, Ns...>,
+                                  make_index_seq<detail::filtered_values<Pred, Ns...>::COUNT>> {};
+
+    // The I-th element
+    template <size_t I, typename>
+    struct seq_at;
+
+    template <size_t I, size_t... Ns>
+    struct seq_at<I, int_seq<Ns...>> {
+        static_assert(I < sizeof...(Ns), "index out of range");
+        constexpr static size_t value = detail::seq_values<Ns...>::at(I);
+    };
+
+    namespace tests {
+
+        template <size_t N> struct is_even { constexpr static bool value = N % 2 == 0; };
+
+        void sequence_truths() {
+            static_assert(same_v<make_index_seq<0>, int_seq<>>, "");
+            static_assert(same_v<make_index_seq<5>, int_seq<0, 1, 2, 3, 4>>, "");
+            static_assert(same_v<make_seq<2>::type, int_seq<0, 1, 2>>, "");
+            static_assert(same_v<repeat_seq<7, 3>::type, int_seq<7, 7, 7>>, "");
+            static_assert(same_v<offset_seq<10, int_seq<0, 2>>::type, int_seq<10, 12>>, "");
+            static_assert(same_v<concat_seq<>::type, int_seq<>>, "");
+            static_assert(same_v<concat_seq<int_seq<1>, int_seq<>, int_seq<2, 3>, int_seq<4>, int_seq<5>>::type,
+                                 int_seq<1, 2, 3, 4, 5>>, "");
+            static_assert(same_v<reverse_seq<int_seq<>>::type, int_seq<>>, "");
+            static_assert(same_v<reverse_seq<int_seq<3, 1, 2>>::type, int_seq<2, 1, 3>>, "");
+            static_assert(same_v<filter_seq<is_even, int_seq<1, 2, 3, 4, 6>>::type, int_seq<2, 4, 6>>, "");
+            static_assert(seq_at<2, int_seq<5, 6, 7>>::value == 7, "");
+
+            // Far beyond the default -ftemplate-depth for one-element-per-level recursion
+            static_assert(make_index_seq<5000>::length == 5000, "");
+            static_assert(same_v<reverse_seq<reverse_seq<make_index_seq<3000>>::type>::type, make_index_seq<3000>>, "");
+            static_assert(filter_seq<is_even, make_index_seq<3001>>::type::length == 1501, "");
+
+        }
+
+    }
 
     template <typename Tup, size_t... N>
     void print_tuple(Tup const& tup, int_seq<N...>) {
@@ -54,7 +230,7 @@ namespace sequences {
     template <typename Tup>
     void print_tuple(Tup const& tup) {
         constexpr size_t size = std::tuple_size<Tup>::value;
-        print_tuple(tup, typename make_seq<size-1>::type{});
+        print_tuple(tup, make_index_seq<size>{});
     }
 
 }
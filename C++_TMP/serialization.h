@@ -0,0 +1,742 @@
+#ifndef TMP_SERIALIZATION_H
+#define TMP_SERIALIZATION_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "common.h"
+#include "member_detection.h"
+#include "traits.h"
+
+// A compact binary format for values, containers of them, pairs and tuples. Containers are recognized
+// with member_detection::is_container, so strings are values and built-in arrays are containers.
+//
+//   trivially copyable value            its bytes, in the machine's byte order
+//   string                              uint64_t length, then the characters aligned for the character type
+//   T[N]                                N elements (one aligned block of bytes if T is trivially copyable)
+//   contiguous container of trivially   uint64_t size, then one block of bytes aligned for the element
+//   copyable elements                   type (counting from the start of the stream)
+//   any other container                 uint64_t size, then each element
+//   pair, tuple                         each member
+//
+// Padding counts from the start of the stream. Files written by save start with a 16-byte header that
+// identifies the type that was saved, so that they can be checked before they are read or mapped. The check
+// sees containers, strings, pairs, tuples and arithmetic types, but a struct or enum only by its size.
+namespace serialization {
+
+    // Collects small writes in a buffer and hands the stream large blocks; big blocks bypass the buffer
+    class buffered_writer {
+        std::ostream& out_;
+        std::unique_ptr<char[]> buffer_;
+        size_t capacity_;
+        size_t size_ = 0;
+        size_t written_ = 0;
+
+        void write_through(void const* data, size_t size) {
+            if (!out_.write(static_cast<char const*>(data), static_cast<std::streamsize>(size)))
+                throw std::runtime_error("can't write serialized data");
+        }
+
+    public:
+        explicit buffered_writer(std::ostream& out, size_t capacity = 64 * 1024)
+                : out_{ out }, buffer_{ new char[capacity] }, capacity_{ capacity } {
+        }
+
+        buffered_writer(buffered_writer const&) = delete;
+        buffered_writer& operator=(buffered_writer const&) = delete;
+
+        // Call flush() first to find out whether the last block could be written
+        ~buffered_writer() {
+            try {
+                flush();
+            } catch (...) {
+            }
+        }
+
+        void write(void const* data, size_t size) {
+            written_ += size;
+            if (size <= capacity_ - size_) {
+                std::memcpy(buffer_.get() + size_, data, size);
+                size_ += size;
+                return;
+            }
+            flush();
+            if (size >= capacity_) {
+                write_through(data, size);
+            } else {
+                std::memcpy(buffer_.get(), data, size);
+                size_ = size;
+            }
+        }
+
+        void flush() {
+            if (size_ != 0) {
+                size_t size = size_;
+                size_ = 0;
+                write_through(buffer_.get(), size);
+            }
+            if (!out_.flush())
+                throw std::runtime_error("can't write serialized data");
+        }
+
+        // Pads with zeros to a multiple of 'alignment' bytes from where the writer started
+        void align(size_t alignment) {
+            static char const zeros[64] = {};
+            // In pieces, for over-aligned types
+            for (size_t padding = (alignment - written_ % alignment) % alignment; padding != 0;) {
+                size_t piece = std::min(padding, sizeof(zeros));
+                write(zeros, piece);
+                padding -= piece;
+            }
+        }
+
+        size_t bytes_written() const {
+            return written_;
+        }
+    };
+
+    // Reads the stream a buffer at a time; big blocks are read straight into their destination
+    class buffered_reader {
+        std::istream& in_;
+        std::unique_ptr<char[]> buffer_;
+        size_t capacity_;
+        size_t next_ = 0;
+        size_t size_ = 0;
+        size_t consumed_ = 0;
+
+        void read_through(void* data, size_t size) {
+            if (!in_.read(static_cast<char*>(data), static_cast<std::streamsize>(size)))
+                throw std::runtime_error("truncated serialized data");
+        }
+
+    public:
+        explicit buffered_reader(std::istream& in, size_t capacity = 64 * 1024)
+                : in_{ in }, buffer_{ new char[capacity] }, capacity_{ capacity } {
+        }
+
+        buffered_reader(buffered_reader const&) = delete;
+        buffered_reader& operator=(buffered_reader const&) = delete;
+
+        void read(void* data, size_t size) {
+            consumed_ += size;
+            size_t buffered = std::min(size, size_ - next_);
+            std::memcpy(data, buffer_.get() + next_, buffered);
+            next_ += buffered;
+            data = static_cast<char*>(data) + buffered;
+            size -= buffered;
+            if (size == 0)
+                return;
+
+            if (size >= capacity_) {
+                read_through(data, size);
+                return;
+            }
+            in_.read(buffer_.get(), static_cast<std::streamsize>(capacity_));
+            size_ = static_cast<size_t>(in_.gcount());
+            next_ = 0;
+            if (size_ < size)
+                throw std::runtime_error("truncated serialized data");
+            std::memcpy(data, buffer_.get(), size);
+            next_ = size;
+        }
+
+        // Skips the padding buffered_writer::align wrote at this point
+        void align(size_t alignment) {
+            char buffer[64];
+            for (size_t padding = (alignment - consumed_ % alignment) % alignment; padding != 0;) {
+                size_t piece = std::min(padding, sizeof(buffer));
+                read(buffer, piece);
+                padding -= piece;
+            }
+        }
+    };
+
+    namespace detail {
+
+        template <typename T>
+        using void_t = void;
+
+        // What a const iterator yields, which for std::vector<bool> is the bool that gets written rather than
+        // the proxy a mutable iterator returns
+        template <typename T>
+        using element_t = std::remove_cv_t<std::remove_reference_t<decltype(*std::begin(val_of_t<T const&>()))>>;
+
+        // Containers whose elements can be written and read as one block of bytes
+        template <typename T>
+        using is_bulk_container_t = bool_t<
+                traits::is_contiguous_iterator<decltype(std::begin(val_of_t<T const&>()))>::value &&
+                std::is_trivially_copyable<element_t<T>>::value
+        >;
+
+        template <typename T, typename = void>
+        struct is_resizable : false_t {
+        };
+
+        template <typename T>
+        struct is_resizable<T, void_t<decltype(val_of_t<T&>().resize(size_t{}))>> : true_t {
+        };
+
+        // The type a container element is read into before it is inserted: map keys lose their const
+        template <typename T>
+        struct storage {
+            using type = T;
+        };
+
+        template <typename K, typename V>
+        struct storage<std::pair<K const, V>> {
+            using type = std::pair<K, V>;
+        };
+
+        template <typename T>
+        using storage_t = typename storage<T>::type;
+
+        // Every overload is declared before any of them is defined, so that the recursive calls for the
+        // elements of a container or the members of a pair find all of them
+        template <typename T>
+        void write(buffered_writer& out, T const& value);
+
+        template <typename CharT, typename Traits, typename Allocator>
+        void write(buffered_writer& out, std::basic_string<CharT, Traits, Allocator> const& value);
+
+        template <typename T, size_t N>
+        void write(buffered_writer& out, T const (&value)[N]);
+
+        template <typename A, typename B>
+        void write(buffered_writer& out, std::pair<A, B> const& value);
+
+        template <typename... Ts>
+        void write(buffered_writer& out, std::tuple<Ts...> const& value);
+
+        template <typename Reader, typename T>
+        void read(Reader& in, T& value);
+
+        template <typename Reader, typename CharT, typename Traits, typename Allocator>
+        void read(Reader& in, std::basic_string<CharT, Traits, Allocator>& value);
+
+        template <typename Reader, typename T, size_t N>
+        void read(Reader& in, T (&value)[N]);
+
+        template <typename Reader, typename A, typename B>
+        void read(Reader& in, std::pair<A, B>& value);
+
+        template <typename Reader, typename... Ts>
+        void read(Reader& in, std::tuple<Ts...>& value);
+
+        void write_size(buffered_writer& out, size_t size) {
+            uint64_t size64 = size;
+            out.write(&size64, sizeof(size64));
+        }
+
+        template <typename Reader>
+        size_t read_size(Reader& in) {
+            uint64_t size;
+            in.read(&size, sizeof(size));
+            return static_cast<size_t>(size);
+        }
+
+        template <typename T>
+        void write_value(buffered_writer& out, T const& value, false_t) {
+            static_assert(std::is_trivially_copyable<T>::value && !std::is_pointer<T>::value,
+                          "only trivially copyable values, strings, containers, pairs and tuples can be serialized");
+            out.write(std::addressof(value), sizeof(T));
+        }
+
+        template <typename T>
+        void write_container(buffered_writer& out, T const& value, true_t) {
+            size_t size = static_cast<size_t>(std::distance(std::begin(value), std::end(value)));
+            write_size(out, size);
+            out.align(alignof(element_t<T>));
+            if (size != 0) {
+                out.write(traits::detail::to_address(std::begin(value)), size * sizeof(element_t<T>));
+            }
+        }
+
+        template <typename T>
+        void write_container(buffered_writer& out, T const& value, false_t) {
+            write_size(out, static_cast<size_t>(std::distance(std::begin(value), std::end(value))));
+            for (auto const& element : value) {
+                write(out, element);
+            }
+        }
+
+        template <typename T>
+        void write_value(buffered_writer& out, T const& value, true_t) {
+            write_container(out, value, is_bulk_container_t<T>{});
+        }
+
+        template <typename T>
+        void write(buffered_writer& out, T const& value) {
+            write_value(out, value, bool_t<member_detection::is_container<T>::value>{});
+        }
+
+        template <typename CharT, typename Traits, typename Allocator>
+        void write(buffered_writer& out, std::basic_string<CharT, Traits, Allocator> const& value) {
+            write_size(out, value.size());
+            out.align(alignof(CharT));
+            out.write(value.data(), value.size() * sizeof(CharT));
+        }
+
+        template <typename T, size_t N>
+        void write_array(buffered_writer& out, T const (&value)[N], true_t) {
+            out.align(alignof(T));
+            out.write(value, sizeof(value));
+        }
+
+        template <typename T, size_t N>
+        void write_array(buffered_writer& out, T const (&value)[N], false_t) {
+            for (auto const& element : value) {
+                write(out, element);
+            }
+        }
+
+        template <typename T, size_t N>
+        void write(buffered_writer& out, T const (&value)[N]) {
+            write_array(out, value, bool_t<std::is_trivially_copyable<T>::value>{});
+        }
+
+        template <typename A, typename B>
+        void write(buffered_writer& out, std::pair<A, B> const& value) {
+            write(out, value.first);
+            write(out, value.second);
+        }
+
+        template <typename Tuple, size_t... Is>
+        void write_members(buffered_writer& out, Tuple const& value, std::index_sequence<Is...>) {
+            (void)std::initializer_list<int>{ (write(out, std::get<Is>(value)), 0)... };
+        }
+
+        template <typename... Ts>
+        void write(buffered_writer& out, std::tuple<Ts...> const& value) {
+            write_members(out, value, std::index_sequence_for<Ts...>{});
+        }
+
+        template <typename Reader, typename T>
+        void read_value(Reader& in, T& value, false_t) {
+            static_assert(std::is_trivially_copyable<T>::value && !std::is_pointer<T>::value,
+                          "only trivially copyable values, strings, containers, pairs and tuples can be serialized");
+            in.read(std::addressof(value), sizeof(T));
+        }
+
+        // Sizes come from the data, so a corrupt one can claim any number of elements. Containers grow by at
+        // most this many bytes of elements at a time as the elements are read, so that truncated data runs
+        // out (and throws) before a size it doesn't back up has been allocated.
+        constexpr size_t READ_STEP_BYTES = 1024 * 1024;
+
+        template <typename T>
+        constexpr size_t read_step() {
+            return sizeof(T) >= READ_STEP_BYTES ? 1 : READ_STEP_BYTES / sizeof(T);
+        }
+
+        // std::array and the like must already have the size that was written
+        template <typename T>
+        void check_fixed_size(T const& value, size_t size) {
+            if (static_cast<size_t>(std::distance(std::begin(value), std::end(value))) != size)
+                throw std::runtime_error("serialized size doesn't match the fixed-size container");
+        }
+
+        // Reads 'size' elements as one block of bytes; vector and friends grow as the elements arrive
+        template <typename Reader, typename T>
+        void read_block(Reader& in, T& value, size_t size, true_t) {
+            using element = element_t<T>;
+            value.clear();
+            for (size_t done = 0; done < size;) {
+                size_t step = std::min(size - done, read_step<element>());
+                value.resize(done + step);
+                in.read(traits::detail::to_address(std::begin(value)) + done, step * sizeof(element));
+                done += step;
+            }
+        }
+
+        template <typename Reader, typename T>
+        void read_block(Reader& in, T& value, size_t size, false_t) {
+            check_fixed_size(value, size);
+            if (size != 0) {
+                in.read(traits::detail::to_address(std::begin(value)), size * sizeof(element_t<T>));
+            }
+        }
+
+        template <typename Reader, typename T>
+        void read_container(Reader& in, T& value, true_t) {
+            size_t size = read_size(in);
+            in.align(alignof(element_t<T>));
+            read_block(in, value, size, is_resizable<T>{});
+        }
+
+        // Containers that can't be filled in place get their elements inserted one by one
+        template <typename Reader, typename T>
+        void read_elements(Reader& in, T& value, size_t size, false_t) {
+            value.clear();
+            for (size_t i = 0; i < size; ++i) {
+                storage_t<typename T::value_type> element;
+                read(in, element);
+                value.insert(value.end(), std::move(element));
+            }
+        }
+
+        template <typename Reader, typename T>
+        void read_in_place(Reader& in, T& value, size_t size, true_t) {
+            value.clear();
+            for (size_t done = 0; done < size;) {
+                size_t step = std::min(size - done, read_step<element_t<T>>());
+                value.resize(done + step);
+                for (auto it = std::begin(value) + done; it != std::end(value); ++it) {
+                    read(in, *it);
+                }
+                done += step;
+            }
+        }
+
+        template <typename Reader, typename T>
+        void read_in_place(Reader& in, T& value, size_t size, false_t) {
+            check_fixed_size(value, size);
+            for (auto& element : value) {
+                read(in, element);
+            }
+        }
+
+        template <typename Reader, typename T>
+        void read_elements(Reader& in, T& value, size_t size, true_t) {
+            read_in_place(in, value, size, is_resizable<T>{});
+        }
+
+        template <typename Reader, typename T>
+        void read_container(Reader& in, T& value, false_t) {
+            size_t size = read_size(in);
+            read_elements(in, value, size, bool_t<
+                    traits::is_contiguous_iterator<decltype(std::begin(value))>::value>{});
+        }
+
+        template <typename Reader, typename T>
+        void read_value(Reader& in, T& value, true_t) {
+            read_container(in, value, is_bulk_container_t<T>{});
+        }
+
+        template <typename Reader, typename T>
+        void read(Reader& in, T& value) {
+            read_value(in, value, bool_t<member_detection::is_container<T>::value>{});
+        }
+
+        template <typename Reader, typename CharT, typename Traits, typename Allocator>
+        void read(Reader& in, std::basic_string<CharT, Traits, Allocator>& value) {
+            size_t size = read_size(in);
+            in.align(alignof(CharT));
+            read_block(in, value, size, true_t{});
+        }
+
+        template <typename Reader, typename T, size_t N>
+        void read_array(Reader& in, T (&value)[N], true_t) {
+            in.align(alignof(T));
+            in.read(value, sizeof(value));
+        }
+
+        template <typename Reader, typename T, size_t N>
+        void read_array(Reader& in, T (&value)[N], false_t) {
+            for (auto& element : value) {
+                read(in, element);
+            }
+        }
+
+        template <typename Reader, typename T, size_t N>
+        void read(Reader& in, T (&value)[N]) {
+            read_array(in, value, bool_t<std::is_trivially_copyable<T>::value>{});
+        }
+
+        template <typename Reader, typename A, typename B>
+        void read(Reader& in, std::pair<A, B>& value) {
+            read(in, value.first);
+            read(in, value.second);
+        }
+
+        template <typename Reader, typename Tuple, size_t... Is>
+        void read_members(Reader& in, Tuple& value, std::index_sequence<Is...>) {
+            (void)std::initializer_list<int>{ (read(in, std::get<Is>(value)), 0)... };
+        }
+
+        template <typename Reader, typename... Ts>
+        void read(Reader& in, std::tuple<Ts...>& value) {
+            read_members(in, value, std::index_sequence_for<Ts...>{});
+        }
+
+    }
+
+    template <typename T>
+    void serialize(buffered_writer& out, T const& value) {
+        detail::write(out, value);
+    }
+
+    template <typename Reader, typename T>
+    void deserialize(Reader& in, T& value) {
+        detail::read(in, value);
+    }
+
+    namespace detail {
+
+        // Reads serialized data straight out of memory. Padding is found from the addresses, which matches the
+        // offsets the writer counted as long as the data starts on a boundary at least as strict as any element's,
+        // as a file mapping or a heap allocation does.
+        class memory_reader {
+            char const* next_;
+            char const* end_;
+        public:
+            memory_reader(char const* begin, char const* end) : next_{ begin }, end_{ end } {
+            }
+
+            // The next n bytes, which are skipped
+            char const* take(size_t n) {
+                if (n > static_cast<size_t>(end_ - next_))
+                    throw std::runtime_error("truncated serialized data");
+                char const* result = next_;
+                next_ += n;
+                return result;
+            }
+
+            // The next n elements of type T, which are skipped
+            template <typename T>
+            T const* take_array(size_t n) {
+                if (n > static_cast<size_t>(end_ - next_) / sizeof(T))
+                    throw std::runtime_error("truncated serialized data");
+                return reinterpret_cast<T const*>(take(n * sizeof(T)));
+            }
+
+            void read(void* data, size_t size) {
+                std::memcpy(data, take(size), size);
+            }
+
+            void align(size_t alignment) {
+                take((alignment - reinterpret_cast<uintptr_t>(next_) % alignment) % alignment);
+            }
+
+            char const* position() const {
+                return next_;
+            }
+
+            char const* end() const {
+                return end_;
+            }
+        };
+
+        // How each type is laid out: a description that two types share only if their serialized forms are
+        // interchangeable, and how to step over a serialized value without building it
+        template <typename T, bool = member_detection::is_container<T>::value>
+        struct format_helper;
+
+        template <typename T>
+        struct format : format_helper<T> {
+        };
+
+        template <typename T>
+        using member_format = format<std::remove_cv_t<std::remove_reference_t<T>>>;
+
+        // Any other trivially copyable type (a struct or an enum) is only described by its size, so two such
+        // types of the same size look alike and the layout check can't tell them apart
+        template <typename T>
+        struct format_helper<T, false> {
+            static void describe(std::string& out) {
+                out += std::is_floating_point<T>::value ? 'f' : std::is_signed<T>::value ? 'i' : std::is_unsigned<T>::value ? 'u' : 'b';
+                out += std::to_string(sizeof(T));
+            }
+
+            static void skip(memory_reader& in) {
+                in.take(sizeof(T));
+            }
+        };
+
+        template <typename T>
+        struct format_helper<T, true> {
+            using element = storage_t<element_t<T>>;
+
+            static void describe(std::string& out) {
+                out += is_bulk_container_t<T>::value ? "B(" : "C(";
+                format<element>::describe(out);
+                out += ')';
+            }
+
+            static void skip(memory_reader& in) {
+                size_t size = read_size(in);
+                if (is_bulk_container_t<T>::value) {
+                    in.align(alignof(element));
+                    in.take_array<element>(size);
+                } else {
+                    for (size_t i = 0; i < size; ++i) {
+                        format<element>::skip(in);
+                    }
+                }
+            }
+        };
+
+        template <typename CharT, typename Traits, typename Allocator>
+        struct format<std::basic_string<CharT, Traits, Allocator>> {
+            static void describe(std::string& out) {
+                out += 's';
+                out += std::to_string(sizeof(CharT));
+            }
+
+            static void skip(memory_reader& in) {
+                size_t size = read_size(in);
+                in.align(alignof(CharT));
+                in.take(size * sizeof(CharT));
+            }
+        };
+
+        template <typename T, size_t N>
+        struct format<T[N]> {
+            static void describe(std::string& out) {
+                out += 'a';
+                out += std::to_string(N);
+                out += '(';
+                format<T>::describe(out);
+                out += ')';
+            }
+
+            static void skip(memory_reader& in) {
+                if (std::is_trivially_copyable<T>::value) {
+                    in.align(alignof(T));
+                    in.take(sizeof(T) * N);
+                } else {
+                    for (size_t i = 0; i < N; ++i) {
+                        format<T>::skip(in);
+                    }
+                }
+            }
+        };
+
+        template <typename A, typename B>
+        struct format<std::pair<A, B>> {
+            static void describe(std::string& out) {
+                out += "P(";
+                member_format<A>::describe(out);
+                out += ',';
+                member_format<B>::describe(out);
+                out += ')';
+            }
+
+            static void skip(memory_reader& in) {
+                member_format<A>::skip(in);
+                member_format<B>::skip(in);
+            }
+        };
+
+        template <typename... Ts>
+        struct format<std::tuple<Ts...>> {
+            static void describe(std::string& out) {
+                out += "T(";
+                (void)std::initializer_list<int>{ (member_format<Ts>::describe(out), out += ',', 0)... };
+                if (out.back() == ',') {
+                    out.back() = ')';
+                } else {
+                    out += ')';
+                }
+            }
+
+            static void skip(memory_reader& in) {
+                (void)std::initializer_list<int>{ (member_format<Ts>::skip(in), 0)... };
+            }
+        };
+
+        constexpr char FILE_MAGIC[8] = { 'T', 'M', 'P', 'S', 'E', 'R', '0', '1' };
+        constexpr size_t HEADER_SIZE = sizeof(FILE_MAGIC) + sizeof(uint64_t);
+
+        // FNV-1a
+        uint64_t hash(std::string const& s) {
+            uint64_t h = 14695981039346656037ull;
+            for (char c : s) {
+                h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+            }
+            return h;
+        }
+
+    }
+
+    // e.g. "C(P(s1,B(f8)))" for map<string, vector<double>>
+    template <typename T>
+    std::string layout_description() {
+        std::string description;
+        detail::format<T>::describe(description);
+        return description;
+    }
+
+    template <typename T>
+    uint64_t layout_hash() {
+        return detail::hash(layout_description<T>());
+    }
+
+    namespace detail {
+
+        // 'header' is the first HEADER_SIZE bytes of the file
+        template <typename T>
+        void check_header(std::string const& file, char const* header) {
+            uint64_t layout;
+            std::memcpy(&layout, header + sizeof(FILE_MAGIC), sizeof(layout));
+            if (!std::equal(std::begin(FILE_MAGIC), std::end(FILE_MAGIC), header))
+                throw std::runtime_error(file + " is not a serialized file");
+            if (layout != layout_hash<T>())
+                throw std::runtime_error(file + " doesn't hold a " + layout_description<T>());
+        }
+
+    }
+
+    // Files start with a magic number and the layout hash of the type that was saved, which load and
+    // mapped_file check before reading anything else
+    template <typename T>
+    void save(std::string const& file, T const& value) {
+        std::ofstream out{ file, std::ios::binary | std::ios::trunc };
+        if (!out)
+            throw std::runtime_error("can't write " + file);
+        buffered_writer writer{ out };
+        uint64_t layout = layout_hash<T>();
+        writer.write(detail::FILE_MAGIC, sizeof(detail::FILE_MAGIC));
+        writer.write(&layout, sizeof(layout));
+        serialize(writer, value);
+        writer.flush();
+    }
+
+    template <typename T>
+    T load(std::string const& file) {
+        std::ifstream in{ file, std::ios::binary };
+        if (!in)
+            throw std::runtime_error("can't read " + file);
+        buffered_reader reader{ in };
+        char header[detail::HEADER_SIZE];
+        reader.read(header, sizeof(header));
+        detail::check_header<T>(file, header);
+        T value;
+        deserialize(reader, value);
+        return value;
+    }
+
+    namespace tests {
+
+        // Only what dump can print: it has no output for pairs, so no maps
+        struct state {
+            std::vector<double> samples;
+            std::vector<std::vector<int>> rows;
+            std::vector<std::string> names;
+        };
+
+        state make_state(size_t size) {
+            state s;
+            for (size_t i = 0; i < size; ++i) {
+                s.samples.push_back(i * 0.5);
+                s.names.push_back("name " + std::to_string(i));
+            }
+            for (size_t i = 0; i < size / 100; ++i) {
+                s.rows.emplace_back(100, static_cast<int>(i));
+            }
+            return s;
+        }
+
+    }
+
+}
+
+#endif //TMP_SERIALIZATION_H
@@ -0,0 +1,36 @@
+#ifndef TMP_SIMD_H
+#define TMP_SIMD_H
+
+#include <cstddef>
+#include <cstring>
+
+namespace compiletime {
+
+    namespace detail {
+
+        // GCC/Clang vector extensions: element-wise arithmetic and comparisons on a register's worth of elements,
+        // which the compiler lowers to SSE2 or AVX2 (or plain scalar code) depending on the target
+#ifdef __AVX__
+        constexpr size_t SIMD_BYTES = 32;
+#else
+        constexpr size_t SIMD_BYTES = 16;
+#endif
+
+        template <typename T>
+        struct simd {
+            constexpr static size_t LANES = SIMD_BYTES / sizeof(T);
+            typedef T type __attribute__((vector_size(SIMD_BYTES)));
+        };
+
+        template <typename T>
+        typename simd<T>::type load(T const* p) {
+            typename simd<T>::type v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+    }
+
+}
+
+#endif //TMP_SIMD_H
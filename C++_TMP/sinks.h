@@ -0,0 +1,179 @@
+#ifndef TMP_SINKS_H
+#define TMP_SINKS_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cerrno>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include "variadics.h"
+
+namespace variadics {
+
+    // Collects records in a per-thread buffer and hands them to write(2) in large batches, so threads don't
+    // contend on every record. A thread's buffer is written out when it grows past flush_size, when its oldest
+    // record has waited flush_interval, on flush(), when the thread exits, and when the sink is destroyed.
+    // A record is never split between two writes.
+    class buffered_fd_sink : public sink {
+        using clock = std::chrono::steady_clock;
+
+        struct thread_buffer {
+            std::mutex lock;
+            std::string data;
+            clock::time_point oldest;
+            int fd = -1; // -1 once the owning sink is gone
+        };
+
+        // The buffers this thread has written to, keyed by sink id; written out when the thread exits
+        struct thread_buffers {
+            std::vector<std::pair<unsigned long long, std::shared_ptr<thread_buffer>>> buffers;
+
+            ~thread_buffers() {
+                for (auto& entry : buffers) {
+                    std::lock_guard<std::mutex> guard{ entry.second->lock };
+                    write_out(*entry.second);
+                }
+            }
+        };
+
+        static std::atomic<unsigned long long>& next_id() {
+            static std::atomic<unsigned long long> id{ 0 };
+            return id;
+        }
+
+        static void write_all(int fd, char const* data, size_t size) {
+            while (size != 0) {
+                ssize_t written = ::write(fd, data, size);
+                if (written < 0) {
+                    if (errno == EINTR)
+                        continue;
+                    return; // Nowhere to report this; drop the batch like a failed stream write would
+                }
+                data += written;
+                size -= static_cast<size_t>(written);
+            }
+        }
+
+        // Must be called with the buffer's lock held
+        static void write_out(thread_buffer& buf) {
+            if (buf.fd != -1 && !buf.data.empty()) {
+                write_all(buf.fd, buf.data.data(), buf.data.size());
+            }
+            buf.data.clear();
+        }
+
+        int fd_;
+        size_t flush_size_;
+        clock::duration flush_interval_;
+        unsigned long long id_ = ++next_id();
+
+        std::mutex buffers_lock_;
+        std::vector<std::shared_ptr<thread_buffer>> buffers_;
+
+        std::mutex flusher_lock_;
+        std::condition_variable flusher_wakeup_;
+        bool stopping_ = false;
+        std::thread flusher_;
+
+        thread_buffer& this_thread_buffer() {
+            static thread_local thread_buffers tls;
+            for (auto& entry : tls.buffers) {
+                if (entry.first == id_)
+                    return *entry.second;
+            }
+            auto buf = std::make_shared<thread_buffer>();
+            buf->fd = fd_;
+            buf->data.reserve(flush_size_);
+            {
+                std::lock_guard<std::mutex> guard{ buffers_lock_ };
+                buffers_.push_back(buf);
+            }
+            // Forget buffers of sinks that have since been destroyed
+            tls.buffers.erase(std::remove_if(tls.buffers.begin(), tls.buffers.end(), [](auto& entry) {
+                std::lock_guard<std::mutex> guard{ entry.second->lock };
+                return entry.second->fd == -1;
+            }), tls.buffers.end());
+            tls.buffers.emplace_back(id_, buf);
+            return *buf;
+        }
+
+        void flush_expired(bool all) {
+            std::lock_guard<std::mutex> guard{ buffers_lock_ };
+            auto now = clock::now();
+            for (auto& buf : buffers_) {
+                std::lock_guard<std::mutex> buf_guard{ buf->lock };
+                if (all || (!buf->data.empty() && now - buf->oldest >= flush_interval_)) {
+                    write_out(*buf);
+                }
+            }
+            // Drop buffers whose threads have exited; their thread_buffers already wrote them out
+            buffers_.erase(std::remove_if(buffers_.begin(), buffers_.end(),
+                                          [](auto const& buf) { return buf.use_count() == 1; }),
+                           buffers_.end());
+        }
+
+        void run_flusher() {
+            std::unique_lock<std::mutex> guard{ flusher_lock_ };
+            while (!stopping_) {
+                flusher_wakeup_.wait_for(guard, flush_interval_);
+                guard.unlock();
+                flush_expired(false);
+                guard.lock();
+            }
+        }
+
+    public:
+        buffered_fd_sink(int fd, size_t flush_size = 64 * 1024,
+                         std::chrono::milliseconds flush_interval = std::chrono::milliseconds{ 100 })
+                : fd_{ fd }, flush_size_{ flush_size }, flush_interval_{ flush_interval } {
+            flusher_ = std::thread{ [this] { run_flusher(); } };
+        }
+
+        buffered_fd_sink(buffered_fd_sink const&) = delete;
+        buffered_fd_sink& operator=(buffered_fd_sink const&) = delete;
+
+        ~buffered_fd_sink() {
+            {
+                std::lock_guard<std::mutex> guard{ flusher_lock_ };
+                stopping_ = true;
+            }
+            flusher_wakeup_.notify_one();
+            flusher_.join();
+
+            std::lock_guard<std::mutex> guard{ buffers_lock_ };
+            for (auto& buf : buffers_) {
+                std::lock_guard<std::mutex> buf_guard{ buf->lock };
+                write_out(*buf);
+                buf->fd = -1;
+            }
+        }
+
+        void write(char const* data, size_t size) override {
+            thread_buffer& buf = this_thread_buffer();
+            std::lock_guard<std::mutex> guard{ buf.lock };
+            if (buf.data.empty()) {
+                buf.oldest = clock::now();
+            }
+            buf.data.append(data, size);
+            if (buf.data.size() >= flush_size_) {
+                write_out(buf);
+            }
+        }
+
+        void flush() override {
+            flush_expired(true);
+        }
+    };
+
+}
+
+#endif //TMP_SINKS_H
@@ -0,0 +1,474 @@
+#ifndef TMP_SOA_H
+#define TMP_SOA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "common.h"
+#include "sequences.h"
+#include "type_lists.h"
+
+// Structure of arrays: a sequence of tuples stored as one contiguous array per tuple element, so that a
+// loop over one field touches only that field's memory. Rows are proxies that refer back into the columns.
+namespace soa {
+
+    // A column, or part of one; T is const for read-only access
+    template <typename T>
+    class span {
+        T* data_ = nullptr;
+        size_t size_ = 0;
+    public:
+        span() = default;
+
+        span(T* data, size_t size) : data_{ data }, size_{ size } {
+        }
+
+        T* data() const {
+            return data_;
+        }
+
+        size_t size() const {
+            return size_;
+        }
+
+        bool empty() const {
+            return size_ == 0;
+        }
+
+        T* begin() const {
+            return data_;
+        }
+
+        T* end() const {
+            return data_ + size_;
+        }
+
+        T& operator[](size_t i) const {
+            return data_[i];
+        }
+    };
+
+    // One element of a soa_vector, or of a const one; valid until the vector reallocates
+    template <typename Vector>
+    class row {
+        Vector* vector_;
+        size_t index_;
+
+        template <size_t... Is>
+        auto to_tuple(sequences::int_seq<Is...>) const {
+            return typename std::remove_const_t<Vector>::value_type{ get<Is>()... };
+        }
+
+        template <typename Tuple, size_t... Is>
+        void assign(Tuple&& value, sequences::int_seq<Is...>) const {
+            (void)std::initializer_list<int>{ (get<Is>() = std::get<Is>(std::forward<Tuple>(value)), 0)... };
+        }
+
+        template <typename Other, size_t... Is>
+        void assign_row(row<Other> const& other, sequences::int_seq<Is...>) const {
+            (void)std::initializer_list<int>{ (get<Is>() = other.template get<Is>(), 0)... };
+        }
+
+    public:
+        using value_type = typename std::remove_const_t<Vector>::value_type;
+
+        row(Vector& vector, size_t index) : vector_{ &vector }, index_{ index } {
+        }
+
+        row(row const&) = default;
+
+        template <size_t I>
+        auto& get() const {
+            return vector_->template column<I>()[index_];
+        }
+
+        // Assigning to a row assigns to its elements and leaves the proxy referring to the same place, so
+        // v[0] = v[1] copies the second element over the first
+        row const& operator=(row const& other) const {
+            assign_row(other, sequences::make_index_seq<std::tuple_size<value_type>::value>{});
+            return *this;
+        }
+
+        // From a row of another vector with the same elements, e.g. a const one
+        template <typename Other, typename = allow_if_t<same_v<typename std::remove_const_t<Other>::value_type, value_type>>>
+        row const& operator=(row<Other> const& other) const {
+            assign_row(other, sequences::make_index_seq<std::tuple_size<value_type>::value>{});
+            return *this;
+        }
+
+        // Assigns the members of a tuple to the row's elements
+        row const& operator=(value_type const& value) const {
+            assign(value, sequences::make_index_seq<std::tuple_size<value_type>::value>{});
+            return *this;
+        }
+
+        row const& operator=(value_type&& value) const {
+            assign(std::move(value), sequences::make_index_seq<std::tuple_size<value_type>::value>{});
+            return *this;
+        }
+
+        // A copy of the elements
+        operator value_type() const {
+            return to_tuple(sequences::make_index_seq<std::tuple_size<value_type>::value>{});
+        }
+    };
+
+    template <typename Vector, size_t... Is>
+    void swap(row<Vector> a, row<Vector> b, sequences::int_seq<Is...>) {
+        using std::swap;
+        (void)std::initializer_list<int>{ (swap(a.template get<Is>(), b.template get<Is>()), 0)... };
+    }
+
+    // Swaps the elements the rows refer to, which is what std::iter_swap (and so std::reverse and std::sort)
+    // does with the vector's iterators
+    template <typename Vector>
+    void swap(row<Vector> a, row<Vector> b) {
+        swap(a, b, sequences::make_index_seq<std::tuple_size<typename row<Vector>::value_type>::value>{});
+    }
+
+    // Like std::get on a tuple
+    template <size_t I, typename Vector>
+    auto& get(row<Vector> const& r) {
+        return r.template get<I>();
+    }
+
+    // Like lab2::get: T must be one of the element types, exactly once
+    template <typename T, typename Vector>
+    auto& get(row<Vector> const& r) {
+        return r.template get<std::remove_const_t<Vector>::template index_of<T>::value>();
+    }
+
+    template <typename Tuple>
+    class soa_vector;
+
+    template <typename... Ts>
+    class soa_vector<std::tuple<Ts...>> {
+        static_assert(typelists::count<bool, Ts...>::value == 0, "vector<bool> has no contiguous storage, use char columns instead");
+
+        using columns = sequences::make_index_seq<sizeof...(Ts)>;
+
+        std::tuple<std::vector<Ts>...> columns_;
+        size_t size_ = 0;
+
+        template <size_t... Is>
+        void reserve(size_t capacity, sequences::int_seq<Is...>) {
+            (void)std::initializer_list<int>{ (std::get<Is>(columns_).reserve(capacity), 0)... };
+        }
+
+        // Drops everything past the first 'size' elements of every column, which puts them back in step
+        // after an append that threw part of the way through
+        template <size_t... Is>
+        void truncate(size_t size, sequences::int_seq<Is...>) {
+            (void)std::initializer_list<int>{
+                    (std::get<Is>(columns_).erase(std::get<Is>(columns_).begin() + std::min(size, std::get<Is>(columns_).size()),
+                                                  std::get<Is>(columns_).end()), 0)... };
+        }
+
+        template <typename Append>
+        void append(Append append) {
+            try {
+                append();
+            } catch (...) {
+                truncate(size_, columns{});
+                throw;
+            }
+            ++size_;
+        }
+
+        template <typename Tuple, size_t... Is>
+        void push_back(Tuple&& value, sequences::int_seq<Is...>) {
+            append([&] {
+                (void)std::initializer_list<int>{
+                        (std::get<Is>(columns_).push_back(std::get<Is>(std::forward<Tuple>(value))), 0)... };
+            });
+        }
+
+        template <typename... Args, size_t... Is>
+        void emplace_back(sequences::int_seq<Is...>, Args&&... args) {
+            append([&] {
+                (void)std::initializer_list<int>{ (std::get<Is>(columns_).emplace_back(std::forward<Args>(args)), 0)... };
+            });
+        }
+
+    public:
+        using value_type = std::tuple<Ts...>;
+        using reference = row<soa_vector>;
+        using const_reference = row<soa_vector const>;
+
+        template <size_t I>
+        using column_type = typelists::at_t<I, Ts...>;
+
+        template <typename T>
+        struct index_of : allow_if_t<typelists::count<T, Ts...>::value == 1, typelists::find<T, Ts...>>::type {
+        };
+
+        template <typename Vector, typename Row>
+        class basic_iterator {
+            Vector* vector_;
+            size_t index_;
+        public:
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type = std::tuple<Ts...>;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = Row;
+
+            basic_iterator(Vector& vector, size_t index) : vector_{ &vector }, index_{ index } {
+            }
+
+            Row operator*() const {
+                return Row{ *vector_, index_ };
+            }
+
+            Row operator[](difference_type n) const {
+                return Row{ *vector_, index_ + n };
+            }
+
+            basic_iterator& operator++() {
+                ++index_;
+                return *this;
+            }
+
+            basic_iterator operator++(int) {
+                basic_iterator previous = *this;
+                ++index_;
+                return previous;
+            }
+
+            basic_iterator& operator--() {
+                --index_;
+                return *this;
+            }
+
+            basic_iterator operator--(int) {
+                basic_iterator previous = *this;
+                --index_;
+                return previous;
+            }
+
+            basic_iterator& operator+=(difference_type n) {
+                index_ += n;
+                return *this;
+            }
+
+            basic_iterator& operator-=(difference_type n) {
+                index_ -= n;
+                return *this;
+            }
+
+            basic_iterator operator+(difference_type n) const {
+                return basic_iterator{ *vector_, index_ + n };
+            }
+
+            basic_iterator operator-(difference_type n) const {
+                return basic_iterator{ *vector_, index_ - n };
+            }
+
+            difference_type operator-(basic_iterator const& other) const {
+                return static_cast<difference_type>(index_) - static_cast<difference_type>(other.index_);
+            }
+
+            bool operator==(basic_iterator const& other) const {
+                return index_ == other.index_;
+            }
+
+            bool operator!=(basic_iterator const& other) const {
+                return index_ != other.index_;
+            }
+
+            bool operator<(basic_iterator const& other) const {
+                return index_ < other.index_;
+            }
+
+            bool operator>(basic_iterator const& other) const {
+                return index_ > other.index_;
+            }
+
+            bool operator<=(basic_iterator const& other) const {
+                return index_ <= other.index_;
+            }
+
+            bool operator>=(basic_iterator const& other) const {
+                return index_ >= other.index_;
+            }
+
+            friend basic_iterator operator+(difference_type n, basic_iterator const& it) {
+                return it + n;
+            }
+        };
+
+        using iterator = basic_iterator<soa_vector, reference>;
+        using const_iterator = basic_iterator<soa_vector const, const_reference>;
+
+        soa_vector() = default;
+
+        soa_vector(std::initializer_list<value_type> values) {
+            reserve(values.size());
+            for (auto const& value : values) {
+                push_back(value);
+            }
+        }
+
+        size_t size() const {
+            return size_;
+        }
+
+        bool empty() const {
+            return size_ == 0;
+        }
+
+        void reserve(size_t capacity) {
+            reserve(capacity, columns{});
+        }
+
+        void clear() {
+            truncate(0, columns{});
+            size_ = 0;
+        }
+
+        void push_back(value_type const& value) {
+            push_back(value, columns{});
+        }
+
+        void push_back(value_type&& value) {
+            push_back(std::move(value), columns{});
+        }
+
+        // One argument per column, each used to construct that column's new element
+        template <typename... Args>
+        void emplace_back(Args&&... args) {
+            static_assert(sizeof...(Args) == sizeof...(Ts), "emplace_back takes one argument per column");
+            emplace_back(columns{}, std::forward<Args>(args)...);
+        }
+
+        void pop_back() {
+            truncate(--size_, columns{});
+        }
+
+        template <size_t I>
+        span<column_type<I>> column() {
+            return { std::get<I>(columns_).data(), size_ };
+        }
+
+        template <size_t I>
+        span<column_type<I> const> column() const {
+            return { std::get<I>(columns_).data(), size_ };
+        }
+
+        template <typename T>
+        span<T> column() {
+            return column<index_of<T>::value>();
+        }
+
+        template <typename T>
+        span<T const> column() const {
+            return column<index_of<T>::value>();
+        }
+
+        reference operator[](size_t i) {
+            return reference{ *this, i };
+        }
+
+        const_reference operator[](size_t i) const {
+            return const_reference{ *this, i };
+        }
+
+        // Throws std::out_of_range
+        reference at(size_t i) {
+            if (i >= size_)
+                throw std::out_of_range("soa_vector index out of range");
+            return (*this)[i];
+        }
+
+        const_reference at(size_t i) const {
+            if (i >= size_)
+                throw std::out_of_range("soa_vector index out of range");
+            return (*this)[i];
+        }
+
+        iterator begin() {
+            return iterator{ *this, 0 };
+        }
+
+        iterator end() {
+            return iterator{ *this, size_ };
+        }
+
+        const_iterator begin() const {
+            return const_iterator{ *this, 0 };
+        }
+
+        const_iterator end() const {
+            return const_iterator{ *this, size_ };
+        }
+    };
+
+    namespace tests {
+
+        // A point in space with an identifier, as stored by the lab1 distance functions' callers
+        using point = std::tuple<double, double, double, int>;
+
+        struct points {
+            std::vector<point> aos;
+            soa_vector<point> soa;
+        };
+
+        std::shared_ptr<points> make_points(size_t count) {
+            auto p = std::make_shared<points>();
+            p->aos.reserve(count);
+            p->soa.reserve(count);
+            for (size_t i = 0; i < count; ++i) {
+                point pt{ i * 0.25, i * 0.5, i * 0.75, static_cast<int>(i) };
+                p->aos.push_back(pt);
+                p->soa.push_back(pt);
+            }
+            return p;
+        }
+
+        double sum_x(std::vector<point> const& aos) {
+            double sum = 0;
+            for (auto const& pt : aos) {
+                sum += std::get<0>(pt);
+            }
+            return sum;
+        }
+
+        double sum_x(soa_vector<point> const& soa) {
+            double sum = 0;
+            for (double x : soa.column<0>()) {
+                sum += x;
+            }
+            return sum;
+        }
+
+        // Points inside the sphere of the given radius around the origin, which reads three of the four fields
+        size_t count_within(std::vector<point> const& aos, double radius) {
+            size_t count = 0;
+            for (auto const& pt : aos) {
+                double x = std::get<0>(pt), y = std::get<1>(pt), z = std::get<2>(pt);
+                count += x * x + y * y + z * z <= radius * radius ? 1 : 0;
+            }
+            return count;
+        }
+
+        size_t count_within(soa_vector<point> const& soa, double radius) {
+            auto xs = soa.column<0>(), ys = soa.column<1>(), zs = soa.column<2>();
+            size_t count = 0;
+            for (size_t i = 0; i < soa.size(); ++i) {
+                count += xs[i] * xs[i] + ys[i] * ys[i] + zs[i] * zs[i] <= radius * radius ? 1 : 0;
+            }
+            return count;
+        }
+
+    }
+
+}
+
+#endif //TMP_SOA_H
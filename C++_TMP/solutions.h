@@ -9,7 +9,10 @@
 #include <numeric>
 #include <utility>
 
+#include "iterators.h"
+#include "linear_search.h"
 #include "member_detection.h"
+#include "type_lists.h"
 
 namespace solutions {
 
@@ -73,37 +76,19 @@ namespace solutions {
 
     namespace lab2 {
 
-        template <typename...>
-        struct count;
-
-        template <typename T>
-        struct count<T> {
-            constexpr static size_t value = 0;
-        };
-
-        template <typename T, typename Head, typename... Tail>
-        struct count<T, Head, Tail...> {
-            constexpr static size_t value =
-                    (std::is_same<T, Head>::value ? 1 : 0) + count<T, Tail...>::value;
-        };
-
-        template <typename...>
-        struct find;
-
-        template <typename T>
-        struct find<T> {
-            // No ::value field, which causes a compile-time error
-        };
+        template <typename T, typename... Ts>
+        struct count : typelists::count<T, Ts...> {};
 
-        template <typename T, typename... Tail>
-        struct find<T, T, Tail...> {
-            constexpr static size_t value = 0;
-        };
+        // Fails to compile when T isn't in the pack
+        template <typename T, typename... Ts>
+        struct find : allow_if_t<typelists::find<T, Ts...>::value != sizeof...(Ts), typelists::find<T, Ts...>>::type {};
 
-        template <typename T, typename Head, typename... Tail>
-        struct find<T, Head, Tail...> {
-            constexpr static size_t value = 1 + find<T, Tail...>::value;
-        };
+        void count_find_test() {
+            static_assert(count<int>::value == 0, "");
+            static_assert(count<int, char, int, double, int>::value == 2, "");
+            static_assert(find<int, int>::value == 0, "");
+            static_assert(find<int, char, int, double, int>::value == 1, "");
+        }
 
         template <typename T, typename... Ts>
         T& get(std::tuple<Ts...>& tup) {
@@ -125,11 +110,30 @@ namespace solutions {
             return false;
         }
 
+        namespace detail {
+
+            template <typename It, typename T>
+            It search_elements(It first, It last, T const& val, false_t) {
+                for (; first != last && !(val == *first); ++first)
+                    ;
+                return first;
+            }
+
+            template <typename It, typename T>
+            It search_elements(It first, It last, T const& val, true_t) {
+                using E = std::decay_t<decltype(*first)>;
+                E key;
+                // A value the element type can't hold equals none of the elements
+                if (!search_key(val, key))
+                    return last;
+                return first + find_kernel(traits::detail::to_address(first), static_cast<size_t>(last - first), key);
+            }
+
+        }
+
         template <typename It, typename T>
         It linear_search(It first, It last, T const& val, std::true_type) {
-            for (; first != last && !(val == *first); ++first)
-                ;
-            return first;
+            return detail::search_elements(first, last, val, is_vectorizable_search_t<It, T>{});
         }
 
         template <typename It, typename T>
@@ -0,0 +1,206 @@
+#ifndef TMP_SYMBOLS_H
+#define TMP_SYMBOLS_H
+
+#include <cstdint>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "common.h"
+#include "traits.h"
+
+namespace traits {
+
+    // Handle to a string interned in a ci_symbol_table. Two symbols from the same table are equal
+    // exactly when their strings are equal ignoring case.
+    class ci_symbol {
+        std::uint32_t id_;
+    public:
+        constexpr explicit ci_symbol(std::uint32_t id = 0) : id_{ id } {
+        }
+
+        constexpr std::uint32_t id() const { return id_; }
+
+        friend constexpr bool operator==(ci_symbol a, ci_symbol b) { return a.id_ == b.id_; }
+        friend constexpr bool operator!=(ci_symbol a, ci_symbol b) { return a.id_ != b.id_; }
+        friend constexpr bool operator<(ci_symbol a, ci_symbol b) { return a.id_ < b.id_; }
+    };
+
+    namespace detail {
+
+        // Bump allocator for the interned strings; nothing is freed until the arena goes away
+        class string_arena {
+            constexpr static size_t CHUNK_SIZE = 64 * 1024;
+
+            std::vector<std::unique_ptr<char[]>> chunks_;
+            char* next_ = nullptr;
+            size_t left_ = 0;
+            size_t reserved_ = 0;
+        public:
+            char* allocate(size_t n) {
+                if (n > left_) {
+                    size_t chunk_size = std::max(n, size_t{ CHUNK_SIZE });
+                    chunks_.emplace_back(new char[chunk_size]);
+                    reserved_ += chunk_size;
+                    // Oversized strings get a chunk of their own; keep filling the current one
+                    if (chunk_size != CHUNK_SIZE) {
+                        return chunks_.back().get();
+                    }
+                    next_ = chunks_.back().get();
+                    left_ = chunk_size;
+                }
+                char* result = next_;
+                next_ += n;
+                left_ -= n;
+                return result;
+            }
+
+            size_t memory_usage() const {
+                return reserved_ + chunks_.capacity() * sizeof(chunks_[0]);
+            }
+        };
+
+        struct ci_key {
+            char const* data;
+            size_t size;
+        };
+
+        struct ci_key_hash {
+            size_t operator()(ci_key const& key) const {
+                return ci_hash{}(key.data, key.size);
+            }
+        };
+
+        struct ci_key_equal {
+            bool operator()(ci_key const& a, ci_key const& b) const {
+                return a.size == b.size && ci_char_traits::compare(a.data, b.data, a.size) == 0;
+            }
+        };
+
+    }
+
+    // Stores each distinct string once, upper-cased and null-terminated, and hands out ci_symbol handles.
+    // The table is split into shards by hash, each with its own reader-writer lock, so concurrent lookups
+    // of existing strings only take shared locks and inserts only contend within a shard.
+    class ci_symbol_table {
+        constexpr static unsigned SHARD_BITS = 4;
+        constexpr static unsigned SHARD_COUNT = 1u << SHARD_BITS;
+        constexpr static std::uint32_t MAX_PER_SHARD = std::uint32_t{ 1 } << (32 - SHARD_BITS);
+
+        struct shard {
+            mutable std::shared_timed_mutex lock;
+            std::unordered_map<detail::ci_key, std::uint32_t, detail::ci_key_hash, detail::ci_key_equal> ids;
+            std::vector<detail::ci_key> strings;
+            detail::string_arena arena;
+        };
+
+        shard shards_[SHARD_COUNT];
+
+        static size_t shard_index(size_t hash) {
+            // The low bits pick the hash bucket inside the shard, so use the high ones here
+            return (hash >> (sizeof(size_t) * 8 - SHARD_BITS)) & (SHARD_COUNT - 1);
+        }
+
+        static ci_symbol make_symbol(size_t shard_index, std::uint32_t index) {
+            return ci_symbol{ (index << SHARD_BITS) | static_cast<std::uint32_t>(shard_index) };
+        }
+
+        shard const& shard_of(ci_symbol sym) const {
+            return shards_[sym.id() & (SHARD_COUNT - 1)];
+        }
+
+    public:
+        ci_symbol intern(char const* s, size_t n) {
+            detail::ci_key key{ s, n };
+            size_t index = shard_index(detail::ci_key_hash{}(key));
+            shard& sh = shards_[index];
+            {
+                std::shared_lock<std::shared_timed_mutex> guard{ sh.lock };
+                auto it = sh.ids.find(key);
+                if (it != sh.ids.end())
+                    return make_symbol(index, it->second);
+            }
+
+            std::unique_lock<std::shared_timed_mutex> guard{ sh.lock };
+            auto it = sh.ids.find(key);
+            if (it != sh.ids.end())
+                return make_symbol(index, it->second);
+
+            if (sh.strings.size() == MAX_PER_SHARD)
+                throw std::length_error("too many symbols");
+
+            char* folded = sh.arena.allocate(n + 1);
+            for (size_t i = 0; i < n; ++i) {
+                folded[i] = detail::ci_toupper(s[i]);
+            }
+            folded[n] = '\0';
+
+            auto id = static_cast<std::uint32_t>(sh.strings.size());
+            sh.strings.push_back(detail::ci_key{ folded, n });
+            sh.ids.emplace(sh.strings.back(), id);
+            return make_symbol(index, id);
+        }
+
+        ci_symbol intern(ci_string const& s) {
+            return intern(s.data(), s.size());
+        }
+
+        // Looks up a string without interning it; returns false if it was never interned
+        bool find(char const* s, size_t n, ci_symbol& result) const {
+            detail::ci_key key{ s, n };
+            size_t index = shard_index(detail::ci_key_hash{}(key));
+            shard const& sh = shards_[index];
+            std::shared_lock<std::shared_timed_mutex> guard{ sh.lock };
+            auto it = sh.ids.find(key);
+            if (it == sh.ids.end())
+                return false;
+            result = make_symbol(index, it->second);
+            return true;
+        }
+
+        bool find(ci_string const& s, ci_symbol& result) const {
+            return find(s.data(), s.size(), result);
+        }
+
+        // The upper-cased string; valid for as long as the table is alive
+        char const* c_str(ci_symbol sym) const {
+            shard const& sh = shard_of(sym);
+            std::shared_lock<std::shared_timed_mutex> guard{ sh.lock };
+            return sh.strings.at(sym.id() >> SHARD_BITS).data;
+        }
+
+        ci_string str(ci_symbol sym) const {
+            return ci_string{ c_str(sym) };
+        }
+
+        size_t size() const {
+            size_t count = 0;
+            for (auto const& sh : shards_) {
+                std::shared_lock<std::shared_timed_mutex> guard{ sh.lock };
+                count += sh.strings.size();
+            }
+            return count;
+        }
+
+        // Bytes held by the table: string storage plus an estimate of the hash table and index overhead
+        size_t memory_usage() const {
+            size_t bytes = sizeof(*this);
+            for (auto const& sh : shards_) {
+                std::shared_lock<std::shared_timed_mutex> guard{ sh.lock };
+                bytes += sh.arena.memory_usage();
+                bytes += sh.strings.capacity() * sizeof(detail::ci_key);
+                bytes += sh.ids.bucket_count() * sizeof(void*);
+                // Each node holds the key/value pair, a next pointer and (with libstdc++) the cached hash
+                bytes += sh.ids.size() * (sizeof(std::pair<detail::ci_key const, std::uint32_t>) + 2 * sizeof(void*));
+            }
+            return bytes;
+        }
+    };
+
+}
+
+#endif //TMP_SYMBOLS_H
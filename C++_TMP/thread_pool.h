@@ -0,0 +1,139 @@
+#ifndef TMP_THREAD_POOL_H
+#define TMP_THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+    // A fixed set of worker threads that run submitted tasks in FIFO order
+    class thread_pool {
+        std::vector<std::thread> workers_;
+        std::deque<std::function<void()>> tasks_;
+        std::mutex lock_;
+        std::condition_variable wakeup_;
+        bool stopping_ = false;
+
+        void run_worker() {
+            for (;;) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> guard{ lock_ };
+                    wakeup_.wait(guard, [this] { return stopping_ || !tasks_.empty(); });
+                    if (tasks_.empty())
+                        return;
+                    task = std::move(tasks_.front());
+                    tasks_.pop_front();
+                }
+                task();
+            }
+        }
+
+    public:
+        explicit thread_pool(unsigned threads = std::max(1u, std::thread::hardware_concurrency())) {
+            for (unsigned i = 0; i < threads; ++i) {
+                workers_.emplace_back([this] { run_worker(); });
+            }
+        }
+
+        thread_pool(thread_pool const&) = delete;
+        thread_pool& operator=(thread_pool const&) = delete;
+
+        // Runs the tasks that were already submitted, then stops the workers
+        ~thread_pool() {
+            {
+                std::lock_guard<std::mutex> guard{ lock_ };
+                stopping_ = true;
+            }
+            wakeup_.notify_all();
+            for (auto& worker : workers_) {
+                worker.join();
+            }
+        }
+
+        unsigned size() const {
+            return static_cast<unsigned>(workers_.size());
+        }
+
+        void submit(std::function<void()> task) {
+            {
+                std::lock_guard<std::mutex> guard{ lock_ };
+                tasks_.push_back(std::move(task));
+            }
+            wakeup_.notify_one();
+        }
+
+        // Calls fn(i) for every i in [0, count) and returns when all calls are done. The calling thread
+        // takes indices too, so this also makes progress when called from inside a pool task.
+        // The first exception thrown by fn is rethrown here; indices not yet started are skipped.
+        template <typename Fn>
+        void parallel_for(size_t count, Fn fn) {
+            if (count == 0)
+                return;
+
+            struct state {
+                std::atomic<size_t> next{ 0 };
+                std::atomic<bool> failed{ false };
+                std::exception_ptr error;
+                std::mutex lock;
+                std::condition_variable done;
+                size_t finished = 0;
+                size_t count;
+            };
+            auto st = std::make_shared<state>();
+            st->count = count;
+
+            auto run = [st, fn]() mutable {
+                size_t ran = 0;
+                for (size_t i; (i = st->next++) < st->count; ++ran) {
+                    if (st->failed)
+                        continue;
+                    try {
+                        fn(i);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> guard{ st->lock };
+                        if (!st->failed.exchange(true)) {
+                            st->error = std::current_exception();
+                        }
+                    }
+                }
+                if (ran != 0) {
+                    std::lock_guard<std::mutex> guard{ st->lock };
+                    st->finished += ran;
+                    if (st->finished == st->count) {
+                        st->done.notify_all();
+                    }
+                }
+            };
+
+            size_t helpers = std::min<size_t>(size(), count - 1);
+            for (size_t i = 0; i < helpers; ++i) {
+                submit(run);
+            }
+            run();
+
+            std::unique_lock<std::mutex> guard{ st->lock };
+            st->done.wait(guard, [&] { return st->finished == st->count; });
+            if (st->error) {
+                std::rethrow_exception(st->error);
+            }
+        }
+
+        // A process-wide pool with one worker per hardware thread
+        static thread_pool& shared() {
+            static thread_pool pool;
+            return pool;
+        }
+    };
+
+}
+
+#endif //TMP_THREAD_POOL_H
@@ -7,44 +7,291 @@
 
 #include <string>
 #include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "common.h"
+#include "iterators.h"
+#include "perf_counters.h"
+#include "thread_pool.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 namespace traits {
 
     namespace detail {
-        // Source: http://en.cppreference.com/w/cpp/string/char_traits
+
+        constexpr bool is_ascii(char c) {
+            return (static_cast<unsigned char>(c) & 0x80) == 0;
+        }
+
+        // std::toupper for ASCII characters in the "C" locale, without the locale lookup
+        constexpr char ascii_toupper(char c) {
+            return (c >= 'a' && c <= 'z') ? static_cast<char>(c - ('a' - 'A')) : c;
+        }
+
+        // ASCII characters are always folded as in the "C" locale, so e.g. under a Turkish locale 'i' still
+        // matches 'I' although std::toupper('i') isn't 'I' there. Only non-ASCII bytes go through the locale.
+        char ci_toupper(char c) {
+            return is_ascii(c) ? ascii_toupper(c) : static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+        }
+
+        // Scalar versions; used for non-ASCII input and for the tails the vector loops leave over.
+        // Like std::char_traits<char>, characters are ordered as unsigned char.
+        int scalar_ci_compare(char const* s1, char const* s2, size_t n) {
+            for (; n != 0; --n, ++s1, ++s2) {
+                unsigned char c1 = ci_toupper(*s1), c2 = ci_toupper(*s2);
+                if (c1 < c2) return -1;
+                if (c1 > c2) return 1;
+            }
+            return 0;
+        }
+
+        char const* scalar_ci_find(char const* s, size_t n, char a) {
+            char const ua = ci_toupper(a);
+            for (; n != 0; --n, ++s) {
+                if (ci_toupper(*s) == ua)
+                    return s;
+            }
+            return nullptr;
+        }
+
+        // The vector loops fold 'a'..'z' to upper case in registers. A block that contains any non-ASCII
+        // byte goes through the scalar version, because the locale may fold those bytes onto ASCII ones.
+#if defined(__SSE2__)
+        __m128i ascii_toupper(__m128i v) {
+            // Move 'a'..'z' to -128..-103 so a single signed comparison finds them
+            __m128i shifted = _mm_add_epi8(v, _mm_set1_epi8(static_cast<char>(0x80 - 'a')));
+            __m128i lower = _mm_cmplt_epi8(shifted, _mm_set1_epi8(static_cast<char>(-128 + 26)));
+            return _mm_sub_epi8(v, _mm_and_si128(lower, _mm_set1_epi8('a' - 'A')));
+        }
+#endif
+
+#if defined(__AVX2__)
+        __m256i ascii_toupper(__m256i v) {
+            __m256i shifted = _mm256_add_epi8(v, _mm256_set1_epi8(static_cast<char>(0x80 - 'a')));
+            __m256i lower = _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(-128 + 26)), shifted);
+            return _mm256_sub_epi8(v, _mm256_and_si256(lower, _mm256_set1_epi8('a' - 'A')));
+        }
+#endif
+
+        int ci_compare(char const* s1, char const* s2, size_t n) {
+            size_t i = 0;
+#if defined(__AVX2__)
+            for (; i + 32 <= n; i += 32) {
+                __m256i a = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(s1 + i));
+                __m256i b = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(s2 + i));
+                if (_mm256_movemask_epi8(_mm256_or_si256(a, b)) != 0) {
+                    if (int result = scalar_ci_compare(s1 + i, s2 + i, 32))
+                        return result;
+                    continue;
+                }
+                unsigned diff = ~static_cast<unsigned>(_mm256_movemask_epi8(
+                        _mm256_cmpeq_epi8(ascii_toupper(a), ascii_toupper(b))));
+                if (diff != 0) {
+                    size_t j = i + __builtin_ctz(diff);
+                    return ascii_toupper(s1[j]) < ascii_toupper(s2[j]) ? -1 : 1; // Both ASCII here
+                }
+            }
+#endif
+#if defined(__SSE2__)
+            for (; i + 16 <= n; i += 16) {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s1 + i));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s2 + i));
+                if (_mm_movemask_epi8(_mm_or_si128(a, b)) != 0) {
+                    if (int result = scalar_ci_compare(s1 + i, s2 + i, 16))
+                        return result;
+                    continue;
+                }
+                unsigned diff = ~static_cast<unsigned>(_mm_movemask_epi8(
+                        _mm_cmpeq_epi8(ascii_toupper(a), ascii_toupper(b)))) & 0xFFFF;
+                if (diff != 0) {
+                    size_t j = i + __builtin_ctz(diff);
+                    return ascii_toupper(s1[j]) < ascii_toupper(s2[j]) ? -1 : 1; // Both ASCII here
+                }
+            }
+#endif
+            return scalar_ci_compare(s1 + i, s2 + i, n - i);
+        }
+
+        char const* ci_find(char const* s, size_t n, char a) {
+            if (!is_ascii(a))
+                return scalar_ci_find(s, n, a);
+
+            size_t i = 0;
+#if defined(__AVX2__)
+            __m256i needle32 = _mm256_set1_epi8(ascii_toupper(a));
+            for (; i + 32 <= n; i += 32) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(s + i));
+                if (_mm256_movemask_epi8(v) != 0) {
+                    if (char const* found = scalar_ci_find(s + i, 32, a))
+                        return found;
+                    continue;
+                }
+                unsigned match = static_cast<unsigned>(_mm256_movemask_epi8(
+                        _mm256_cmpeq_epi8(ascii_toupper(v), needle32)));
+                if (match != 0)
+                    return s + i + __builtin_ctz(match);
+            }
+#endif
+#if defined(__SSE2__)
+            __m128i needle16 = _mm_set1_epi8(ascii_toupper(a));
+            for (; i + 16 <= n; i += 16) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(s + i));
+                if (_mm_movemask_epi8(v) != 0) {
+                    if (char const* found = scalar_ci_find(s + i, 16, a))
+                        return found;
+                    continue;
+                }
+                unsigned match = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(ascii_toupper(v), needle16)));
+                if (match != 0)
+                    return s + i + __builtin_ctz(match);
+            }
+#endif
+            return scalar_ci_find(s + i, n - i, a);
+        }
+
+        // Originally from http://en.cppreference.com/w/cpp/string/char_traits
         struct ci_char_traits : public std::char_traits<char> {
             static bool eq(char c1, char c2) {
-                return std::toupper(c1) == std::toupper(c2);
+                return ci_toupper(c1) == ci_toupper(c2);
             }
 
             static bool lt(char c1, char c2) {
-                return std::toupper(c1) < std::toupper(c2);
+                return static_cast<unsigned char>(ci_toupper(c1)) < static_cast<unsigned char>(ci_toupper(c2));
             }
 
             static int compare(char const* s1, char const* s2, size_t n) {
-                while (n-- != 0) {
-                    if (std::toupper(*s1) < std::toupper(*s2)) return -1;
-                    if (std::toupper(*s1) > std::toupper(*s2)) return 1;
-                    ++s1;
-                    ++s2;
-                }
-                return 0;
+                return ci_compare(s1, s2, n);
             }
 
-            static char const* find(char const* s, int n, char a) {
-                auto const ua(std::toupper(a));
-                while (n-- != 0) {
-                    if (std::toupper(*s) == ua)
-                        return s;
-                    s++;
-                }
-                return nullptr;
+            static char const* find(char const* s, size_t n, char const& a) {
+                return ci_find(s, n, a);
             }
         };
+    }
+
+    typedef std::basic_string<char, detail::ci_char_traits> ci_string;
+
+    // FNV-1a over the upper-cased characters, so strings that ci_char_traits considers equal hash the same
+    struct ci_hash {
+        size_t operator()(char const* s, size_t n) const {
+            unsigned long long hash = 14695981039346656037ull;
+            for (size_t i = 0; i < n; ++i) {
+                hash ^= static_cast<unsigned char>(detail::ci_toupper(s[i]));
+                hash *= 1099511628211ull;
+            }
+            return static_cast<size_t>(hash);
+        }
+
+        size_t operator()(ci_string const& s) const {
+            return (*this)(s.data(), s.size());
+        }
+    };
+
+    // ci_string keeps its characters contiguous like std::string
+    template <>
+    struct is_contiguous_iterator<ci_string::iterator> : true_t {
+    };
+
+    template <>
+    struct is_contiguous_iterator<ci_string::const_iterator> : true_t {
+    };
+
+    // Types that can be moved to a new address and have the old one forgotten by copying their bytes, without
+    // running the move constructor and destructor. That's every trivially copyable type, and any other type that
+    // opts in by specializing this (e.g. one that only holds a unique_ptr and owns nothing that points back at it).
+    template <typename T>
+    struct is_trivially_relocatable : bool_t<std::is_trivially_copyable<T>::value> {
+    };
+
+    namespace detail {
+
+        template <typename It>
+        using iter_value_t = std::decay_t<decltype(*val_of_t<It>())>;
+
+        // Both ranges are contiguous and hold the same trivially copyable type, so bytes can be copied between them
+        template <typename InIt, typename OutIt>
+        struct is_safe_to_memmove_iter {
+            using decayed_in_t = iter_value_t<InIt>;
+            using decayed_out_t = iter_value_t<OutIt>;
+            using type = typename bool_t<
+                    same_v<decayed_in_t, decayed_out_t> &&
+                    is_contiguous_iterator<InIt>::value &&
+                    is_contiguous_iterator<OutIt>::value &&
+                    std::is_trivially_copyable<decayed_in_t>::value
+            >::type;
+        };
+
+        template <typename InIt, typename OutIt>
+        using is_safe_to_memmove_iter_t = typename is_safe_to_memmove_iter<InIt, OutIt>::type;
+
+        // Like is_safe_to_memmove_iter, but the type must also have a single object representation for each value,
+        // so that equal bytes means equal values (which isn't true for floating point or types with padding)
+        template <typename It1, typename It2>
+        struct is_safe_to_memcmp_iter {
+            using decayed_t = iter_value_t<It1>;
+            using type = typename bool_t<
+                    same_v<decayed_t, iter_value_t<It2>> &&
+                    is_contiguous_iterator<It1>::value &&
+                    is_contiguous_iterator<It2>::value &&
+                    (std::is_integral<decayed_t>::value || std::is_enum<decayed_t>::value || std::is_pointer<decayed_t>::value)
+            >::type;
+        };
+
+        template <typename It1, typename It2>
+        using is_safe_to_memcmp_iter_t = typename is_safe_to_memcmp_iter<It1, It2>::type;
+
+        template <typename It>
+        struct is_safe_to_memset_iter {
+            using type = typename bool_t<
+                    is_contiguous_iterator<It>::value &&
+                    std::is_trivially_copyable<iter_value_t<It>>::value
+            >::type;
+        };
+
+        template <typename It>
+        using is_safe_to_memset_iter_t = typename is_safe_to_memset_iter<It>::type;
+
+        template <typename InIt, typename OutIt>
+        struct is_safe_to_relocate_iter {
+            using decayed_in_t = iter_value_t<InIt>;
+            using type = typename bool_t<
+                    same_v<decayed_in_t, iter_value_t<OutIt>> &&
+                    is_contiguous_iterator<InIt>::value &&
+                    is_contiguous_iterator<OutIt>::value &&
+                    is_trivially_relocatable<decayed_in_t>::value
+            >::type;
+        };
+
+        template <typename InIt, typename OutIt>
+        using is_safe_to_relocate_iter_t = typename is_safe_to_relocate_iter<InIt, OutIt>::type;
+
+        template <typename InIt, typename OutIt>
+        OutIt memmove_range(InIt first, InIt last, OutIt out) {
+            auto count = last - first;
+            if (count > 0) {
+                std::memmove(to_address(out), to_address(first), count * sizeof(iter_value_t<InIt>));
+            }
+            return out + count;
+        }
 
         template <typename InIt, typename OutIt>
         OutIt copy_helper(InIt first, InIt last, OutIt out, false_t) {
-            std::cout << "using slow copy_helper for OutIt = " << typeid(OutIt).name() << '\n';
             for (; first != last; ++first, ++out) {
                 *out = *first;
             }
@@ -53,34 +300,309 @@ namespace traits {
 
         template <typename InIt, typename OutIt>
         OutIt copy_helper(InIt first, InIt last, OutIt out, true_t) {
-            std::cout << "using fast copy_helper for OutIt = " << typeid(OutIt).name() << '\n';
-            size_t count = (last - first);
-            std::memmove(out, first, count * sizeof(*first));
-            return out + count;
+            return memmove_range(first, last, out);
         }
 
         template <typename InIt, typename OutIt>
-        struct is_safe_to_memmove_iter {
-            using decayed_in_t = std::decay_t<decltype(*val_of_t<InIt>())>;
-            using decayed_out_t = std::decay_t<decltype(*val_of_t<OutIt>())>;
-            using type = typename bool_t<
-                    same_v<decayed_in_t, decayed_out_t> &&
-                    std::is_pointer<InIt>::value &&
-                    std::is_trivially_copy_assignable<decayed_in_t>::value
-            >::type;
-        };
+        OutIt move_helper(InIt first, InIt last, OutIt out, false_t) {
+            for (; first != last; ++first, ++out) {
+                *out = std::move(*first);
+            }
+            return out;
+        }
 
         template <typename InIt, typename OutIt>
-        using is_safe_to_memmove_iter_t = typename is_safe_to_memmove_iter<InIt, OutIt>::type;
-    }
+        OutIt move_helper(InIt first, InIt last, OutIt out, true_t) {
+            return memmove_range(first, last, out);
+        }
 
-    typedef std::basic_string<char, detail::ci_char_traits> ci_string;
+        template <typename It, typename T>
+        void fill_helper(It first, It last, T const& value, false_t) {
+            for (; first != last; ++first) {
+                *first = value;
+            }
+        }
+
+        template <typename It, typename T>
+        void fill_helper(It first, It last, T const& value, true_t) {
+            using value_t = iter_value_t<It>;
+            value_t const converted = value;
+            unsigned char bytes[sizeof(value_t)];
+            std::memcpy(bytes, &converted, sizeof(value_t));
+
+            // memset can only produce values whose bytes are all the same, like 0, -1 or any single-byte value
+            if (!std::all_of(std::begin(bytes), std::end(bytes), [&](unsigned char b) { return b == bytes[0]; })) {
+                fill_helper(first, last, converted, false_t{});
+                return;
+            }
+            auto count = last - first;
+            if (count > 0) {
+                std::memset(to_address(first), bytes[0], count * sizeof(value_t));
+            }
+        }
+
+        template <typename It1, typename It2>
+        bool equal_helper(It1 first1, It1 last1, It2 first2, false_t) {
+            for (; first1 != last1; ++first1, ++first2) {
+                if (!(*first1 == *first2))
+                    return false;
+            }
+            return true;
+        }
+
+        template <typename It1, typename It2>
+        bool equal_helper(It1 first1, It1 last1, It2 first2, true_t) {
+            auto count = last1 - first1;
+            return count <= 0 ||
+                   std::memcmp(to_address(first1), to_address(first2), count * sizeof(iter_value_t<It1>)) == 0;
+        }
+
+        template <typename InIt, typename OutIt>
+        OutIt uninitialized_copy_helper(InIt first, InIt last, OutIt out, false_t) {
+            using value_t = iter_value_t<OutIt>;
+            OutIt current = out;
+            try {
+                for (; first != last; ++first, ++current) {
+                    ::new (static_cast<void*>(to_address(current))) value_t(*first);
+                }
+            } catch (...) {
+                for (; out != current; ++out) {
+                    to_address(out)->~value_t();
+                }
+                throw;
+            }
+            return current;
+        }
+
+        template <typename InIt, typename OutIt>
+        OutIt uninitialized_copy_helper(InIt first, InIt last, OutIt out, true_t) {
+            return memmove_range(first, last, out);
+        }
+
+        template <typename InIt, typename OutIt>
+        OutIt uninitialized_relocate_helper(InIt first, InIt last, OutIt out, false_t) {
+            using value_t = iter_value_t<InIt>;
+            static_assert(std::is_nothrow_move_constructible<value_t>::value,
+                          "relocating requires a non-throwing move constructor");
+            for (; first != last; ++first, ++out) {
+                ::new (static_cast<void*>(to_address(out))) value_t(std::move(*first));
+                to_address(first)->~value_t();
+            }
+            return out;
+        }
+
+        template <typename InIt, typename OutIt>
+        OutIt uninitialized_relocate_helper(InIt first, InIt last, OutIt out, true_t) {
+            return memmove_range(first, last, out);
+        }
+
+        // memcpy with non-temporal stores, which write around the cache instead of evicting what's in it
+        void stream_copy(char* dst, char const* src, size_t n) {
+#if defined(__SSE2__)
+            size_t head = std::min(n, static_cast<size_t>(-reinterpret_cast<std::uintptr_t>(dst) & 15));
+            std::memcpy(dst, src, head);
+            dst += head;
+            src += head;
+            n -= head;
+            for (; n >= 64; n -= 64, dst += 64, src += 64) {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + 16));
+                __m128i c = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + 32));
+                __m128i d = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + 48));
+                _mm_stream_si128(reinterpret_cast<__m128i*>(dst), a);
+                _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 16), b);
+                _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 32), c);
+                _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 48), d);
+            }
+            _mm_sfence();
+#endif
+            std::memcpy(dst, src, n);
+        }
+
+        template <typename InIt, typename OutIt, typename Options>
+        OutIt bulk_copy_helper(InIt first, InIt last, OutIt out, Options const&, false_t) {
+            return copy_helper(first, last, out, false_t{});
+        }
+
+        template <typename InIt, typename OutIt, typename Options>
+        OutIt bulk_copy_helper(InIt first, InIt last, OutIt out, Options const& options, true_t) {
+            auto count = last - first;
+            size_t bytes = count > 0 ? count * sizeof(iter_value_t<InIt>) : 0;
+            if (bytes < options.streaming_threshold) {
+                return memmove_range(first, last, out);
+            }
+
+            char* dst = reinterpret_cast<char*>(to_address(out));
+            char const* src = reinterpret_cast<char const*>(to_address(first));
+            if (dst < src + bytes && src < dst + bytes) {
+                return memmove_range(first, last, out); // Overlapping ranges must be copied in order
+            }
+
+            parallel::thread_pool& pool = options.pool ? *options.pool : parallel::thread_pool::shared();
+            size_t threads = options.threads != 0 ? options.threads : pool.size() + 1;
+            size_t chunks = std::max<size_t>(1, std::min(threads, bytes / std::max<size_t>(options.min_chunk, 1)));
+            // Inner chunk boundaries fall on cache lines of the destination, so no two threads write to the same line
+            std::uintptr_t base = reinterpret_cast<std::uintptr_t>(dst);
+            size_t chunk_size = bytes / chunks;
+            auto boundary = [=](size_t i) -> size_t {
+                if (i == 0 || i == chunks)
+                    return i == 0 ? 0 : bytes;
+                return std::min<size_t>(((base + i * chunk_size + 63) & ~std::uintptr_t{ 63 }) - base, bytes);
+            };
+            pool.parallel_for(chunks, [=](size_t i) {
+                perfcounters::region region{ "traits::bulk_copy chunk" };
+                size_t begin = boundary(i), end = boundary(i + 1);
+                if (begin < end) {
+                    stream_copy(dst + begin, src + begin, end - begin);
+                }
+            });
+            return out + count;
+        }
+
+    }
 
     template <typename InIt, typename OutIt>
     OutIt copy(InIt first, InIt last, OutIt out) {
         return detail::copy_helper(first, last, out,
                                    typename detail::is_safe_to_memmove_iter_t<InIt, OutIt>::type{});
     }
+
+    template <typename InIt, typename OutIt>
+    OutIt move(InIt first, InIt last, OutIt out) {
+        return detail::move_helper(first, last, out,
+                                   typename detail::is_safe_to_memmove_iter_t<InIt, OutIt>::type{});
+    }
+
+    template <typename It, typename T>
+    void fill(It first, It last, T const& value) {
+        detail::fill_helper(first, last, value, typename detail::is_safe_to_memset_iter_t<It>::type{});
+    }
+
+    template <typename It1, typename It2>
+    bool equal(It1 first1, It1 last1, It2 first2) {
+        return detail::equal_helper(first1, last1, first2,
+                                    typename detail::is_safe_to_memcmp_iter_t<It1, It2>::type{});
+    }
+
+    // Constructs copies of [first, last) in the uninitialized storage at out
+    template <typename InIt, typename OutIt>
+    OutIt uninitialized_copy(InIt first, InIt last, OutIt out) {
+        return detail::uninitialized_copy_helper(first, last, out,
+                                                 typename detail::is_safe_to_memmove_iter_t<InIt, OutIt>::type{});
+    }
+
+    // Moves [first, last) into the uninitialized storage at out and destroys the originals,
+    // leaving [first, last) uninitialized
+    template <typename InIt, typename OutIt>
+    OutIt uninitialized_relocate(InIt first, InIt last, OutIt out) {
+        return detail::uninitialized_relocate_helper(first, last, out,
+                                                     typename detail::is_safe_to_relocate_iter_t<InIt, OutIt>::type{});
+    }
+
+    // Tuning for bulk_copy. Ranges smaller than streaming_threshold bytes are copied with a plain memmove; larger ones
+    // are split into chunks of at least min_chunk bytes, copied on up to 'threads' threads (0 means the pool's workers
+    // plus the caller) with non-temporal stores. 'pool' defaults to parallel::thread_pool::shared().
+    struct bulk_copy_options {
+        size_t streaming_threshold = 8 * 1024 * 1024;
+        size_t min_chunk = 1024 * 1024;
+        unsigned threads = 0;
+        parallel::thread_pool* pool = nullptr;
+    };
+
+    // Like copy, for large ranges that aren't going to be read again soon
+    template <typename InIt, typename OutIt>
+    OutIt bulk_copy(InIt first, InIt last, OutIt out, bulk_copy_options const& options = bulk_copy_options{}) {
+        return detail::bulk_copy_helper(first, last, out, options,
+                                        typename detail::is_safe_to_memmove_iter_t<InIt, OutIt>::type{});
+    }
+
+    namespace tests {
+
+        // The original per-character std::toupper loops, for comparison
+        int toupper_compare(char const* s1, char const* s2, size_t n) {
+            while (n-- != 0) {
+                if (std::toupper(*s1) < std::toupper(*s2)) return -1;
+                if (std::toupper(*s1) > std::toupper(*s2)) return 1;
+                ++s1;
+                ++s2;
+            }
+            return 0;
+        }
+
+        char const* toupper_find(char const* s, size_t n, char a) {
+            auto const ua(std::toupper(a));
+            while (n-- != 0) {
+                if (std::toupper(*s) == ua)
+                    return s;
+                s++;
+            }
+            return nullptr;
+        }
+
+        template <typename Fn>
+        void measure_throughput(std::string const& description, size_t size, Fn fn) {
+            size_t iterations = std::max<size_t>(1, (size_t{ 256 } << 20) / size);
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t i = 0; i < iterations; ++i) {
+                fn();
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            double seconds = std::chrono::duration<double>(end - start).count();
+            std::cout << "[" << description << " " << size << " bytes] "
+                      << (static_cast<double>(size) * iterations / seconds / (1 << 20)) << " MB/s\n";
+        }
+
+    }
+
+    void bulk_copy_perf() {
+        constexpr size_t MAX_SIZE = 256 * 1024 * 1024;
+        std::vector<char> src(MAX_SIZE, 'x'), dst(MAX_SIZE, 'y');
+        unsigned max_threads = std::max(2u, std::thread::hardware_concurrency());
+
+        for (size_t size = 1024 * 1024; size <= MAX_SIZE; size *= 4) {
+            tests::measure_throughput("memmove          ", size, [&] {
+                std::memmove(dst.data(), src.data(), size);
+            });
+            for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+                parallel::thread_pool pool{ threads - 1 };
+                bulk_copy_options options;
+                options.streaming_threshold = 0;
+                options.threads = threads;
+                options.pool = &pool;
+                std::string description = "bulk_copy " + std::to_string(threads) + " thr";
+                description.resize(17, ' ');
+                tests::measure_throughput(description, size, [&] {
+                    traits::bulk_copy(src.begin(), src.begin() + size, dst.begin(), options);
+                });
+            }
+        }
+        if (perfcounters::default_policy::enabled) {
+            perfcounters::write_report(std::cout, perfcounters::snapshot());
+        }
+    }
+
+    void ci_traits_perf() {
+        for (size_t size = 16; size <= 64 * 1024; size *= 4) {
+            std::string lower(size, 'x'), upper(size, 'X');
+            lower.back() = 'y';
+            upper.back() = 'Z';
+            volatile int result = 0;
+            volatile bool found = false;
+
+            tests::measure_throughput("toupper compare", size, [&] {
+                result = tests::toupper_compare(lower.data(), upper.data(), size);
+            });
+            tests::measure_throughput("ci      compare", size, [&] {
+                result = detail::ci_char_traits::compare(lower.data(), upper.data(), size);
+            });
+            tests::measure_throughput("toupper find   ", size, [&] {
+                found = tests::toupper_find(lower.data(), size, 'Y') != nullptr;
+            });
+            tests::measure_throughput("ci      find   ", size, [&] {
+                found = detail::ci_char_traits::find(lower.data(), size, 'Y') != nullptr;
+            });
+        }
+    }
 }
 
 #endif //TMP_TRAITS_H
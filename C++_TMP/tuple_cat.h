@@ -6,9 +6,7 @@
 #define TMP_TUPLE_CAT_H
 
 #include <tuple>
-#include <chrono>
-#include <vector>
-#include <complex>
+#include <type_traits>
 
 #include "sequences.h"
 
@@ -70,34 +68,22 @@ namespace tupcat
 
 		// Concatenates any number of index sequences into a single index sequence
 		template <typename... Sequences>
-		struct cat_index_sequence;
-
-		template <size_t... Indices>
-		struct cat_index_sequence<int_seq<Indices...>> : int_seq<Indices...>
-		{
-		};
-
-		template <size_t... Indices1, size_t... Indices2>
-		struct cat_index_sequence<int_seq<Indices1...>, int_seq<Indices2...>>
-			: int_seq<Indices1..., Indices2...>
-		{
-		};
-
-		template <size_t... Indices1, size_t... Indices2, typename... Sequences>
-		struct cat_index_sequence<int_seq<Indices1...>, int_seq<Indices2...>, Sequences...>
-			: cat_index_sequence<int_seq<Indices1..., Indices2...>, cat_index_sequence<Sequences...>>
+		struct cat_index_sequence : concat_seq<Sequences...>
 		{
 		};
 
 		// Make a sequence (I, ..., I) of size Length
 		template <size_t I, size_t Length>
-		struct make_repeated_sequence :
-                cat_index_sequence<int_seq<I>, typename make_repeated_sequence<I, Length - 1>::type>
+		struct make_repeated_sequence : repeat_seq<I, Length>
 		{
 		};
 
-		template <size_t I>
-		struct make_repeated_sequence<I, 1> : int_seq<I>
+		template <size_t I, typename Offsets, size_t... Lengths>
+		struct repeating_index_sequence_impl;
+
+		template <size_t I, size_t... Offsets, size_t... Lengths>
+		struct repeating_index_sequence_impl<I, int_seq<Offsets...>, Lengths...>
+			: concat_seq<typename repeat_seq<I + Offsets, Lengths>::type...>
 		{
 		};
 
@@ -106,31 +92,15 @@ namespace tupcat
 		template <typename, size_t... Lengths>
 		struct repeating_index_sequence;
 
-		template <size_t I, size_t Length>
-		struct repeating_index_sequence<std::integral_constant<size_t, I>, Length>
-			: make_repeated_sequence<I, Length>
-		{
-		};
-
-		template <size_t I, size_t Length, size_t... TailLengths>
-		struct repeating_index_sequence<std::integral_constant<size_t, I>, Length, TailLengths...>
-			: cat_index_sequence<typename make_repeated_sequence<I, Length>::type
-							   , typename repeating_index_sequence<std::integral_constant<size_t, I + 1>, TailLengths...>::type>
+		template <size_t I, size_t... Lengths>
+		struct repeating_index_sequence<std::integral_constant<size_t, I>, Lengths...>
+			: repeating_index_sequence_impl<I, make_index_seq<sizeof...(Lengths)>, Lengths...>
 		{
 		};
 
 		// Generates an index sequence that concatenates make_index_sequence<k> for each k in Lengths...
 		template <size_t... Lengths>
-		struct variable_index_sequence;
-
-		template <size_t Head>
-		struct variable_index_sequence<Head> : make_index_seq<Head>
-		{
-		};
-
-		template <size_t Head, size_t... Tail>
-		struct variable_index_sequence<Head, Tail...>
-			: cat_index_sequence<typename variable_index_sequence<Head>::type, typename variable_index_sequence<Tail...>::type>
+		struct variable_index_sequence : concat_seq<make_index_seq<Lengths>...>
 		{
 		};
 
@@ -148,6 +118,94 @@ namespace tupcat
 		}
 	}
 
+	// Lazy concatenation. The view holds references to the source tuples, and get<I> maps the flat index I
+	// to a (tuple, element) pair at compile time, so nothing is copied. The sources must outlive the view.
+	namespace lazy
+	{
+		using namespace sequences;
+
+		template <typename... Tuples>
+		class tuple_cat_view
+		{
+			using outer_indices = typename twodimensional::repeating_index_sequence<
+					std::integral_constant<size_t, 0>,
+					std::tuple_size<std::remove_const_t<Tuples>>::value...
+			>::type;
+			using inner_indices = typename twodimensional::variable_index_sequence<
+					std::tuple_size<std::remove_const_t<Tuples>>::value...
+			>::type;
+
+			std::tuple<Tuples&...> tuples_;
+
+		public:
+			constexpr static size_t size = outer_indices::length;
+
+			explicit tuple_cat_view(Tuples&... tuples) : tuples_{ tuples... }
+			{
+			}
+
+			// A reference to the element, const only if its source tuple is
+			template <size_t I>
+			decltype(auto) get() const
+			{
+				static_assert(I < size, "index out of range");
+				return std::get<seq_at<I, inner_indices>::value>(std::get<seq_at<I, outer_indices>::value>(tuples_));
+			}
+		};
+
+		template <size_t I, typename... Tuples>
+		decltype(auto) get(tuple_cat_view<Tuples...> const& view)
+		{
+			return view.template get<I>();
+		}
+
+		// Only binds to lvalues, so the view can't outlive temporaries passed to it
+		template <typename... Tuples>
+		tuple_cat_view<Tuples...> make_tuple_cat_view(Tuples&... tuples)
+		{
+			return tuple_cat_view<Tuples...>{ tuples... };
+		}
+	}
+
+	// Eager concatenation that builds the result with a single constructor call and no intermediate tuples.
+	// Elements of rvalue tuples are moved into place and elements of lvalue tuples are copied. Element types
+	// are kept as they are in the sources, like std::tuple_cat does.
+	namespace inplace
+	{
+		using namespace sequences;
+
+		template <typename Outer, typename Inner, typename... Tuples>
+		struct cat_result;
+
+		template <size_t... Ix, size_t... Jx, typename... Tuples>
+		struct cat_result<int_seq<Ix...>, int_seq<Jx...>, Tuples...>
+			: is<std::tuple<std::tuple_element_t<Jx, typelists::at_t<Ix, Tuples...>>...>>
+		{
+		};
+
+		// 'tuples' is a tuple of references from forward_as_tuple, so getting from it as an rvalue yields
+		// an rvalue exactly for the tuples that were passed as rvalues
+		template <typename Result, typename Tuples, size_t... Ix, size_t... Jx>
+		Result cat_all(Tuples&& tuples, int_seq<Ix...>, int_seq<Jx...>)
+		{
+			return Result(std::get<Jx>(std::get<Ix>(std::move(tuples)))...);
+		}
+
+		template <typename... Tuples>
+		auto tuple_cat(Tuples&&... tuples)
+		{
+			using ixs = typename twodimensional::repeating_index_sequence<
+					std::integral_constant<size_t, 0>,
+					std::tuple_size<std::decay_t<Tuples>>::value...
+			>::type;
+			using jxs = typename twodimensional::variable_index_sequence<
+					std::tuple_size<std::decay_t<Tuples>>::value...
+			>::type;
+			using result = typename cat_result<ixs, jxs, std::decay_t<Tuples>...>::type;
+			return cat_all<result>(std::forward_as_tuple(std::forward<Tuples>(tuples)...), ixs{}, jxs{});
+		}
+	}
+
     namespace tests
     {
         using namespace sequences;
@@ -179,59 +237,33 @@ namespace tupcat
                                   int_seq<0, 0, 0, 1, 1, 2, 2, 2, 2>
                     , repeating_index_sequence<std::integral_constant<size_t, 0>, 3, 2, 4>::type
                       >::value, "");
-        }
 
-#ifdef _DEBUG
-        constexpr int ITERATIONS = 100000;
-#else
-        constexpr int ITERATIONS = 10000000;
-#endif
+            static_assert(std::is_same<
+                                  int_seq<0, 1, 2, 0, 1>
+                    , cat_index_sequence<make_index_seq<0>, make_index_seq<3>, make_index_seq<2>>::type
+                      >::value, "");
+
+            static_assert(variable_index_sequence<2000, 0, 3000>::type::length == 5000, "");
+            static_assert(repeating_index_sequence<std::integral_constant<size_t, 0>, 2000, 0, 3000>::type::length == 5000, "");
 
-        template <typename Catter>
-        void measure(std::string const& description, Catter catter)
-        {
-            {
-                std::cout << "simple tuple  ";
-                auto tup1 = std::make_tuple(1, 2);
-                auto tup2 = std::make_tuple('a', 4.0f);
-                auto tup3 = std::make_tuple(3ull, L'c', 17);
-                auto tup4 = std::make_tuple(0, 47.0);
-                volatile int size = 0;
-                auto start = std::chrono::high_resolution_clock::now();
-                for (int i = 0; i < ITERATIONS; ++i)
-                {
-                    auto result = catter(tup1, tup2, tup3, tup4);
-                    size = std::get<0>(result);
-                }
-                auto end = std::chrono::high_resolution_clock::now();
-                std::cout << "[" << description << "] elapsed " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us\n";
-            }
-
-            {
-                std::cout << "complex tuple ";
-                auto tup1 = std::make_tuple(17, std::string{ "hello" }, std::complex<double>(14.0, 3.5));
-                auto tup2 = std::make_tuple('a', std::vector<int>{1, 2, 3}, 42);
-                auto tup3 = std::make_tuple(3ull, L'c', 17);
-                volatile int size = 0;
-                auto start = std::chrono::high_resolution_clock::now();
-                for (int i = 0; i < ITERATIONS; ++i)
-                {
-                    auto result = catter(tup1, tup2, tup3);
-                    size = std::get<0>(result);
-                }
-                auto end = std::chrono::high_resolution_clock::now();
-                std::cout << "[" << description << "] elapsed " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << " us\n";
-            }
         }
 
     }
+}
 
-    void tuple_cat_perf()
-    {
-        tests::measure("simple cat  ", [](auto&&... args) { return direct::tuple_cat(args...); });
-        tests::measure("2d     cat", [](auto&&... args) { return twodimensional::tuple_cat(args...); });
-        tests::measure("empty loop", [](auto&&... args) { return std::make_tuple(1); });
-    }
+namespace std
+{
+	template <typename... Tuples>
+	struct tuple_size<tupcat::lazy::tuple_cat_view<Tuples...>>
+		: integral_constant<size_t, tupcat::lazy::tuple_cat_view<Tuples...>::size>
+	{
+	};
+
+	template <size_t I, typename... Tuples>
+	struct tuple_element<I, tupcat::lazy::tuple_cat_view<Tuples...>>
+	{
+		using type = remove_reference_t<decltype(declval<tupcat::lazy::tuple_cat_view<Tuples...> const&>().template get<I>())>;
+	};
 }
 
 #endif //TMP_TUPLE_CAT_H
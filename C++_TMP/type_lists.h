@@ -0,0 +1,261 @@
+#ifndef TMP_TYPE_LISTS_H
+#define TMP_TYPE_LISTS_H
+
+#include <cstddef>
+#include <initializer_list>
+#include <type_traits>
+#include <utility>
+
+#include "common.h"
+
+// Algorithms over type packs that don't recurse one type at a time. Per-type facts are computed by
+// expanding the pack into an initializer_list and scanning it in a constexpr function, and the I-th type
+// is picked by overload resolution against a class that inherits from every (index, type) pair. Either
+// way the instantiation depth stays constant no matter how long the pack is.
+namespace typelists {
+
+    template <typename... Ts>
+    struct type_list {
+        constexpr static size_t size = sizeof...(Ts);
+        using type = type_list<Ts...>;
+    };
+
+    namespace detail {
+
+        template <bool...>
+        struct bool_pack {};
+
+        template <size_t I, typename T>
+        struct indexed : is<T> {};
+
+        template <typename, typename...>
+        struct indexer;
+
+        template <size_t... Is, typename... Ts>
+        struct indexer<std::index_sequence<Is...>, Ts...> : indexed<Is, Ts>... {};
+
+        template <size_t I, typename T>
+        is<T> type_at(indexed<I, T> const&);
+
+        // Deducing I fails when T is a base more than once, which leaves only the void const* overload
+        template <typename T, size_t I>
+        std::integral_constant<size_t, I> unique_index_of(indexed<I, T> const*);
+
+        template <typename T>
+        std::integral_constant<size_t, ~size_t{ 0 }> unique_index_of(void const*);
+
+        constexpr size_t count_true(std::initializer_list<bool> flags) {
+            size_t count = 0;
+            for (bool flag : flags) {
+                count += flag ? 1 : 0;
+            }
+            return count;
+        }
+
+        // Index of the first true flag, or the number of flags if there is none
+        constexpr size_t first_true(std::initializer_list<bool> flags) {
+            size_t index = 0;
+            for (bool flag : flags) {
+                if (flag)
+                    return index;
+                ++index;
+            }
+            return index;
+        }
+
+        // Index of the first largest value
+        constexpr size_t max_index(std::initializer_list<size_t> values) {
+            size_t index = 0, max_index = 0;
+            size_t max = 0;
+            for (size_t value : values) {
+                if (index == 0 || value > max) {
+                    max = value;
+                    max_index = index;
+                }
+                ++index;
+            }
+            return max_index;
+        }
+
+        template <size_t N>
+        struct index_array {
+            size_t values[N + 1];
+        };
+
+        template <size_t N>
+        constexpr index_array<N> true_indices(std::initializer_list<bool> flags) {
+            index_array<N> result{};
+            size_t index = 0, next = 0;
+            for (bool flag : flags) {
+                if (flag) {
+                    result.values[next++] = index;
+                }
+                ++index;
+            }
+            return result;
+        }
+
+        // The positions of the true flags, as an index_sequence
+        template <bool... Flags>
+        struct kept_indices {
+            constexpr static size_t COUNT = count_true({ Flags... });
+            constexpr static index_array<COUNT> INDICES = true_indices<COUNT>({ Flags... });
+
+            template <size_t... Js>
+            static std::index_sequence<INDICES.values[Js]...> make(std::index_sequence<Js...>);
+
+            using type = decltype(make(std::make_index_sequence<COUNT>{}));
+        };
+
+        template <typename Indices, typename... Ts>
+        struct pick;
+
+    }
+
+    // The I-th type in the pack
+    template <size_t I, typename... Ts>
+    struct at : decltype(detail::type_at<I>(val_of_t<detail::indexer<std::index_sequence_for<Ts...>, Ts...> const&>())) {};
+
+    template <size_t I, typename... Ts>
+    using at_t = typename at<I, Ts...>::type;
+
+    namespace detail {
+
+        template <size_t... Is, typename... Ts>
+        struct pick<std::index_sequence<Is...>, Ts...> : type_list<at_t<Is, Ts...>...> {};
+
+    }
+
+    template <template <class> class Pred, typename... Ts>
+    struct all : same_t<detail::bool_pack<true, bool(Pred<Ts>::value)...>,
+                        detail::bool_pack<bool(Pred<Ts>::value)..., true>> {};
+
+    template <template <class> class Pred, typename... Ts>
+    struct any : bool_t<!same_t<detail::bool_pack<false, bool(Pred<Ts>::value)...>,
+                                detail::bool_pack<bool(Pred<Ts>::value)..., false>>::value> {};
+
+    template <template <class> class Pred, typename... Ts>
+    struct count_if {
+        constexpr static size_t value = detail::count_true({ bool(Pred<Ts>::value)... });
+    };
+
+    // How many times T appears in the pack
+    template <typename T, typename... Ts>
+    struct count {
+        constexpr static size_t value = detail::count_true({ same_t<T, Ts>::value... });
+    };
+
+    // Index of the first type that satisfies Pred, or sizeof...(Ts) if none does
+    template <template <class> class Pred, typename... Ts>
+    struct find_if {
+        constexpr static size_t value = detail::first_true({ bool(Pred<Ts>::value)... });
+    };
+
+    // Index of the first occurrence of T, or sizeof...(Ts) if it's not there
+    template <typename T, typename... Ts>
+    struct find {
+        constexpr static size_t value = detail::first_true({ same_t<T, Ts>::value... });
+    };
+
+    // Index of T if it appears exactly once, or sizeof...(Ts) if it's missing or repeated. Like at, this is one
+    // overload resolution rather than a scan of the pack.
+    template <typename T, typename... Ts>
+    struct unique_index {
+        constexpr static size_t found = decltype(detail::unique_index_of<T>(
+                val_of_t<detail::indexer<std::index_sequence_for<Ts...>, Ts...> const*>()))::value;
+        constexpr static size_t value = found == ~size_t{ 0 } ? sizeof...(Ts) : found;
+    };
+
+    // The first of the largest types by sizeof; an empty pack has no ::type
+    template <typename... Ts>
+    struct max_by_size : at<detail::max_index({ sizeof(Ts)... }), Ts...> {};
+
+    template <>
+    struct max_by_size<> {};
+
+    // The types that satisfy Pred, in their original order, as a type_list
+    template <template <class> class Pred, typename... Ts>
+    struct filter : detail::pick<typename detail::kept_indices<bool(Pred<Ts>::value)...>::type, Ts...> {};
+
+    namespace detail {
+
+        template <typename, typename...>
+        struct unique_impl;
+
+        template <size_t... Is, typename... Ts>
+        struct unique_impl<std::index_sequence<Is...>, Ts...>
+                : pick<typename kept_indices<(find<Ts, Ts...>::value == Is)...>::type, Ts...> {};
+
+    }
+
+    // The first occurrence of every type, in their original order, as a type_list
+    template <typename... Ts>
+    struct unique : detail::unique_impl<std::index_sequence_for<Ts...>, Ts...> {};
+
+    namespace tests {
+
+        template <size_t I>
+        struct padded {
+            char data[I % 13 + 1];
+        };
+
+        template <typename T> struct is_small { constexpr static bool value = sizeof(T) <= 4; };
+
+        // Long enough that one-type-per-level recursion would hit the default template depth limit
+        template <size_t... Is>
+        void long_list_test(std::index_sequence<Is...>) {
+            constexpr size_t N = sizeof...(Is);
+            static_assert(same_v<typename max_by_size<padded<Is>...>::type, padded<12>>, "");
+            static_assert(same_v<at_t<N - 1, padded<Is>...>, padded<N - 1>>, "");
+            static_assert(all<std::is_class, padded<Is>...>::value, "");
+            static_assert(!all<is_small, padded<Is>...>::value, "");
+            static_assert(any<is_small, padded<Is>...>::value, "");
+            static_assert(count_if<is_small, padded<Is>...>::value == (N / 13) * 4 + 4, "");
+            static_assert(find<padded<N - 1>, padded<Is>...>::value == N - 1, "");
+            static_assert(unique_index<padded<N - 1>, padded<Is>...>::value == N - 1, "");
+            static_assert(find_if<is_small, padded<12>, padded<Is>...>::value == 1, "");
+            static_assert(filter<is_small, padded<Is>...>::type::size == count_if<is_small, padded<Is>...>::value, "");
+            static_assert(unique<padded<Is % 13>...>::type::size == 13, "");
+        }
+
+        void type_lists_test() {
+            static_assert(same_v<at_t<0, int, char>, int>, "");
+            static_assert(same_v<at_t<1, int, char>, char>, "");
+
+            static_assert(same_v<typename max_by_size<char, long long, long>::type, long long>, "");
+            static_assert(same_v<typename max_by_size<int, float>::type, int>, "");
+
+            static_assert(all<is_small>::value, "");
+            static_assert(all<is_small, int, char>::value, "");
+            static_assert(!all<is_small, int, double>::value, "");
+            static_assert(!any<is_small>::value, "");
+            static_assert(any<is_small, double, char>::value, "");
+            static_assert(!any<is_small, double, long long>::value, "");
+
+            static_assert(count<int>::value == 0, "");
+            static_assert(count<int, int, char, int>::value == 2, "");
+            static_assert(count_if<is_small, int, double, char>::value == 2, "");
+
+            static_assert(find<int>::value == 0, "");
+            static_assert(find<int, char, int, int>::value == 1, "");
+            static_assert(find<int, char, double>::value == 2, "");
+            static_assert(find_if<is_small, double, char>::value == 1, "");
+
+            static_assert(unique_index<int>::value == 0, "");
+            static_assert(unique_index<int, char, int>::value == 1, "");
+            static_assert(unique_index<int, char, int, int>::value == 3, "");
+            static_assert(unique_index<int, char, double>::value == 2, "");
+
+            static_assert(same_v<typename filter<is_small>::type, type_list<>>, "");
+            static_assert(same_v<typename filter<is_small, double, char, long long, int>::type, type_list<char, int>>, "");
+            static_assert(same_v<typename unique<>::type, type_list<>>, "");
+            static_assert(same_v<typename unique<int, char, int, double, char>::type, type_list<int, char, double>>, "");
+
+            long_list_test(std::make_index_sequence<1000>{});
+        }
+
+    }
+
+}
+
+#endif //TMP_TYPE_LISTS_H
@@ -0,0 +1,208 @@
+#ifndef TMP_TYPE_REGISTRY_H
+#define TMP_TYPE_REGISTRY_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <typeindex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "type_lists.h"
+
+// Objects looked up by their type, one per type: services, per-subsystem counters and the like. Every type
+// is given a small dense index, so finding its object is indexing an array rather than hashing a key.
+namespace registry {
+
+    // A fixed set of types known at compile time, stored inline. Each type may appear only once.
+    template <typename... Ts>
+    class static_registry {
+        std::tuple<Ts...> values_;
+
+    public:
+        template <typename T>
+        struct index_of : std::integral_constant<size_t, typelists::unique_index<T, Ts...>::value> {
+            static_assert(typelists::unique_index<T, Ts...>::value != sizeof...(Ts), "T must appear exactly once");
+        };
+
+        static_registry() = default;
+
+        explicit static_registry(Ts... values) : values_{ std::move(values)... } {
+        }
+
+        template <typename T>
+        T& get() {
+            return std::get<index_of<T>::value>(values_);
+        }
+
+        template <typename T>
+        T const& get() const {
+            return std::get<index_of<T>::value>(values_);
+        }
+
+        constexpr static size_t size() {
+            return sizeof...(Ts);
+        }
+    };
+
+    namespace detail {
+
+        // Indices are handed out process-wide, the first time each type is looked up in any registry
+        struct type_ids {
+            static size_t next() {
+                static std::atomic<size_t> next_id{ 0 };
+                return next_id++;
+            }
+
+            template <typename T>
+            static size_t of() {
+                static size_t const id = next();
+                return id;
+            }
+        };
+
+    }
+
+    // Types are added while the program runs. Lookups check a function-local static (the type's index) and
+    // then load one slot; they don't lock, so a registry that is changed while other threads read it must be
+    // guarded by the caller.
+    class type_registry {
+        struct slot {
+            void* value = nullptr;
+            void (*destroy)(void*) = nullptr;
+        };
+
+        std::vector<slot> slots_;
+
+        template <typename T>
+        static void destroy(void* value) {
+            delete static_cast<T*>(value);
+        }
+
+        slot* find_slot(size_t id) {
+            return id < slots_.size() && slots_[id].value != nullptr ? &slots_[id] : nullptr;
+        }
+
+    public:
+        type_registry() = default;
+
+        type_registry(type_registry const&) = delete;
+        type_registry& operator=(type_registry const&) = delete;
+
+        ~type_registry() {
+            for (auto& s : slots_) {
+                if (s.value != nullptr) {
+                    s.destroy(s.value);
+                }
+            }
+        }
+
+        // Throws std::logic_error if there already is a T
+        template <typename T, typename... Args>
+        T& emplace(Args&&... args) {
+            size_t id = detail::type_ids::of<T>();
+            if (find_slot(id) != nullptr)
+                throw std::logic_error("type is already registered");
+            if (id >= slots_.size()) {
+                slots_.resize(id + 1);
+            }
+            std::unique_ptr<T> value{ new T(std::forward<Args>(args)...) };
+            slots_[id] = slot{ value.get(), &destroy<T> };
+            return *value.release();
+        }
+
+        // nullptr if there is no T
+        template <typename T>
+        T* find() {
+            slot* s = find_slot(detail::type_ids::of<T>());
+            return s == nullptr ? nullptr : static_cast<T*>(s->value);
+        }
+
+        template <typename T>
+        T const* find() const {
+            return const_cast<type_registry*>(this)->find<T>();
+        }
+
+        // Throws std::out_of_range if there is no T
+        template <typename T>
+        T& get() {
+            T* value = find<T>();
+            if (value == nullptr)
+                throw std::out_of_range("type is not registered");
+            return *value;
+        }
+
+        template <typename T>
+        T const& get() const {
+            return const_cast<type_registry*>(this)->get<T>();
+        }
+
+        template <typename T>
+        bool contains() const {
+            return find<T>() != nullptr;
+        }
+
+        // Destroys the T, if there is one
+        template <typename T>
+        void erase() {
+            if (slot* s = find_slot(detail::type_ids::of<T>())) {
+                s->destroy(s->value);
+                *s = slot{};
+            }
+        }
+    };
+
+    namespace tests {
+
+        template <size_t N>
+        struct counter {
+            uint64_t value = 0;
+        };
+
+        // The usual alternative: objects keyed by std::type_index in a hash table
+        class hashed_registry {
+            std::unordered_map<std::type_index, std::shared_ptr<void>> values_;
+
+        public:
+            template <typename T>
+            T& emplace() {
+                auto value = std::make_shared<T>();
+                values_[typeid(T)] = value;
+                return *value;
+            }
+
+            template <typename T>
+            T& get() {
+                auto it = values_.find(typeid(T));
+                if (it == values_.end())
+                    throw std::out_of_range("type is not registered");
+                return *static_cast<T*>(it->second.get());
+            }
+        };
+
+        template <typename Registry, size_t... Ns>
+        void emplace_counters(Registry& r, std::index_sequence<Ns...>) {
+            (void)std::initializer_list<int>{ (r.template emplace<counter<Ns>>(), 0)... };
+        }
+
+        // Bumps every counter once, each found by its type
+        template <typename Registry, size_t... Ns>
+        void bump_counters(Registry& r, std::index_sequence<Ns...>) {
+            (void)std::initializer_list<int>{ (++r.template get<counter<Ns>>().value, 0)... };
+        }
+
+        template <size_t... Ns>
+        using static_counters = static_registry<counter<Ns>...>;
+
+        template <size_t... Ns>
+        static_counters<Ns...> make_static_counters(std::index_sequence<Ns...>);
+
+    }
+
+}
+
+#endif //TMP_TYPE_REGISTRY_H
@@ -5,42 +5,151 @@
 #ifndef TMP_VARIADICS_H
 #define TMP_VARIADICS_H
 
+#include <atomic>
 #include <iostream>
+#include <mutex>
+#include <streambuf>
 #include <type_traits>
 #include <stdexcept>
 #include <string>
 
 namespace variadics {
 
-    void print() {}
+    // Destination for everything print and printf produce. Each call to write() is one record: the complete
+    // output of a single print/printf call, which a sink must never interleave with other records.
+    class sink {
+    public:
+        virtual void write(char const* data, size_t size) = 0;
+        virtual void flush() {}
+        virtual ~sink() {}
+    };
 
-    template <typename T, typename... Ts>
-    void print(T&& v, Ts&&... vs) {
-        std::cout << v << '\n';
-        print(std::forward<Ts>(vs)...);
-    }
+    class ostream_sink : public sink {
+        std::ostream& os_;
+        std::mutex lock_;
+    public:
+        ostream_sink(std::ostream& os) : os_(os) {
+        }
 
-    void printf(std::string const& format) {
-        for (auto c : format) {
-            if (c == '%')
-                throw std::logic_error("too many format specifiers provided");
+        void write(char const* data, size_t size) override {
+            std::lock_guard<std::mutex> guard{ lock_ };
+            os_.write(data, static_cast<std::streamsize>(size));
+        }
 
-            std::cout << c;
+        void flush() override {
+            std::lock_guard<std::mutex> guard{ lock_ };
+            os_.flush();
         }
-    }
+    };
+
+    namespace detail {
+
+        std::atomic<sink*>& current_sink() {
+            static ostream_sink cout_sink{ std::cout };
+            static std::atomic<sink*> current{ &cout_sink };
+            return current;
+        }
+
+        class record_streambuf : public std::streambuf {
+            std::string data_;
+        public:
+            std::string const& data() const { return data_; }
+            void clear() { data_.clear(); }
+        protected:
+            int_type overflow(int_type c) override {
+                if (!traits_type::eq_int_type(c, traits_type::eof())) {
+                    data_.push_back(traits_type::to_char_type(c));
+                }
+                return traits_type::not_eof(c);
+            }
+            std::streamsize xsputn(char const* s, std::streamsize n) override {
+                data_.append(s, static_cast<size_t>(n));
+                return n;
+            }
+        };
+
+        // Collects the output of one print/printf call in a per-thread buffer and hands it to the
+        // current sink as a single record. Nested calls append to the outermost record.
+        class record {
+            struct state {
+                record_streambuf buf;
+                std::ostream os{ &buf };
+                int depth = 0;
+            };
+
+            static state& this_thread_state() {
+                static thread_local state st;
+                return st;
+            }
+
+            state& st_;
+        public:
+            record() : st_(this_thread_state()) {
+                ++st_.depth;
+            }
+
+            ~record() {
+                if (--st_.depth == 0 && !st_.buf.data().empty()) {
+                    current_sink().load()->write(st_.buf.data().data(), st_.buf.data().size());
+                    st_.buf.clear();
+                }
+            }
 
-    template <typename T, typename... Rest>
-    void printf(std::string const& format, T&& t, Rest&&... rest) {
-        for (auto i = 0ull; i < format.size(); ++i) {
-            if (format[i] == '%') {
-                std::cout << std::forward<T>(t);
-                printf(format.substr(i+1), std::forward<Rest>(rest)...);
-                return;
-            } else {
-                std::cout << format[i];
+            std::ostream& stream() { return st_.os; }
+        };
+
+        void print(std::ostream&) {}
+
+        template <typename T, typename... Ts>
+        void print(std::ostream& os, T&& v, Ts&&... vs) {
+            os << v << '\n';
+            print(os, std::forward<Ts>(vs)...);
+        }
+
+        void printf(std::ostream& os, std::string const& format) {
+            for (auto c : format) {
+                if (c == '%')
+                    throw std::logic_error("too many format specifiers provided");
+
+                os << c;
             }
         }
-        throw std::logic_error("too many parameters provided");
+
+        template <typename T, typename... Rest>
+        void printf(std::ostream& os, std::string const& format, T&& t, Rest&&... rest) {
+            for (auto i = 0ull; i < format.size(); ++i) {
+                if (format[i] == '%') {
+                    os << std::forward<T>(t);
+                    printf(os, format.substr(i+1), std::forward<Rest>(rest)...);
+                    return;
+                } else {
+                    os << format[i];
+                }
+            }
+            throw std::logic_error("too many parameters provided");
+        }
+
+    }
+
+    // Replaces the sink used by print and printf, and returns the previous one. The default sink writes to std::cout.
+    sink& set_sink(sink& s) {
+        return *detail::current_sink().exchange(&s);
+    }
+
+    sink& get_sink() {
+        return *detail::current_sink().load();
+    }
+
+    template <typename... Ts>
+    void print(Ts&&... vs) {
+        detail::record rec;
+        detail::print(rec.stream(), std::forward<Ts>(vs)...);
+    }
+
+    template <typename... Ts>
+    void printf(std::string const& format, Ts&&... ts) {
+        detail::record rec;
+        detail::printf(rec.stream(), format, std::forward<Ts>(ts)...);
     }
 
 }